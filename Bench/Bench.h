@@ -0,0 +1,88 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// timing helpers shared by the benchmarks, each benchmark is an executable of its own
+// that prints one line per case, with the case name padded so runs line up in a diff
+
+inline double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs body iterations times and returns the nanoseconds each took on average
+template <typename F>
+double nsPerIteration(uint64_t iterations, F body)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < iterations; ++i)
+		body(i);
+	return secondsSince(start) * 1e9 / iterations;
+}
+
+// folds a value into a sink the optimizer can't see through, so the work producing it stays
+template <typename T>
+inline void keep(const T & value)
+{
+	static volatile unsigned char sink;
+	unsigned char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	unsigned char sum = 0;
+	for (size_t i = 0; i < sizeof(T); ++i)
+		sum ^= bytes[i];
+	sink = sink ^ sum;
+}
+
+// every latency of a run, for exact percentiles
+class LatencySamples
+{
+public:
+	void add(std::chrono::steady_clock::duration elapsed)
+	{
+		samples.push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		sorted = false;
+	}
+
+	// in microseconds, p between 0 and 1
+	double percentile(double p)
+	{
+		if (samples.empty())
+			return 0.0;
+		if (!sorted)
+		{
+			std::sort(samples.begin(), samples.end());
+			sorted = true;
+		}
+		size_t index = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+		return samples[index] / 1000.0;
+	}
+
+	size_t count() const { return samples.size(); }
+
+private:
+	std::vector<uint64_t> samples;
+	bool sorted = false;
+};
+
+inline void report(const std::string & name, double value, const std::string & unit)
+{
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(14) << value << " " << unit << std::endl;
+}
+
+inline void reportLatency(const std::string & name, LatencySamples & samples)
+{
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2)
+		<< " p50 " << samples.percentile(0.5) << " us, p99 " << samples.percentile(0.99)
+		<< " us, p999 " << samples.percentile(0.999) << " us" << std::endl;
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include <rpc/server.h>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#if defined(__GLIBC__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include "Bench.h"
+#include "SerializablePose.h"
+#include "Simulation.h"
+#include "Handlers.h"
+#include "UdpServer.h"
+#include "ServerBinder.h"
+#include "NetworkClient.h"
+#include "InputDevice.h"
+using namespace std;
+
+// counts the heap allocations of a player's client in a steady state match, through the
+// real NetworkClient: the render thread packing its input and handing it over, picking
+// up snapshots and unpacking the remote poses, and the network thread sending the input
+// and decoding the snapshots. the server and the other player run in a child process,
+// so everything counted here is the client's. every malloc, calloc and realloc is
+// counted, which covers operator new and msgpack's sbuffers and zones alike.
+// over udp a steady frame must not allocate at all. the rpc transport is reported too,
+// it still allocates every frame inside rpclib: rpc::client::send packs each call into a
+// fresh sbuffer and every subscription is an async_call with its own promise and zone.
+// the jitter buffer the game samples remote poses from is left out, it is not network
+// serialization. only built to count with glibc, elsewhere it says so and passes.
+
+#define FRAME_RATE 90
+#define WARMUP_SECONDS 2
+#define MEASURE_SECONDS 5
+#define READY_TIMEOUT_SECONDS 10
+#define SERVER_WORKERS 2
+#define BALL_PACKS 100000
+
+static atomic<uint64_t> allocations(0);
+static atomic<uint64_t> renderAllocations(0);
+static atomic<bool> counting(false);
+
+// set on the thread that plays the render loop
+static thread_local bool renderThread = false;
+
+#if defined(__GLIBC__)
+// glibc's own entry points, forwarding to them sidesteps dlsym, which allocates itself
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * memory, size_t size);
+
+static inline void countAllocation()
+{
+	if (counting.load(memory_order_relaxed))
+	{
+		++allocations;
+		if (renderThread)
+			++renderAllocations;
+	}
+}
+
+extern "C" void * malloc(size_t size)
+{
+	countAllocation();
+	return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t count, size_t size)
+{
+	countAllocation();
+	return __libc_calloc(count, size);
+}
+
+extern "C" void * realloc(void * memory, size_t size)
+{
+	countAllocation();
+	return __libc_realloc(memory, size);
+}
+
+// the other player, driven like the game would, for as long as the bench runs
+static void runOpponent(int quitFd)
+{
+	ScriptedDevice device(LEAP, FRAME_RATE);
+	TrackedPoses tracked;
+	device.poll(0, tracked);
+	NetworkClient network(DEFAULT_ROOM, LEAP, true);
+	network.start(serializePose(tracked.head), serializePose(tracked.hand));
+
+	const chrono::nanoseconds period(1000000000 / FRAME_RATE);
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	char byte;
+	for (long long frame = 0; read(quitFd, &byte, 1) < 0; ++frame)
+	{
+		device.poll(frame, tracked);
+		s_PlayerState local;
+		local.head = packPose(serializePose(tracked.head));
+		local.hand = packPose(serializePose(tracked.hand));
+		network.sendPlayerState(local);
+		s_WorldSnapshot snapshot;
+		while (network.receiveSnapshot(snapshot));
+
+		next += period;
+		this_thread::sleep_until(next);
+	}
+	network.stop();
+}
+
+// the server and the other player, until the parent closes its end of quitFd
+static void runServer(int readyFd, int quitFd)
+{
+	rpc::server srv(SERVER_IP, SERVER_PORT);
+	ServerBinder binder(srv);
+	bindHandlers(binder);
+	binder.bindMethodTable();
+	rooms.create();
+	srv.async_run(SERVER_WORKERS);
+	UdpServer udp(rooms);
+	if (!udp.start(SERVER_UDP_PORT))
+		cerr << "Unable to open udp port " << SERVER_UDP_PORT << endl;
+
+	atomic<bool> simulating(true);
+	thread simulation([&]() {
+		const chrono::nanoseconds period(1000000000 / TICK_RATE);
+		chrono::steady_clock::time_point next = chrono::steady_clock::now();
+		while (simulating)
+		{
+			rooms.tick(TICK_SECONDS);
+			next += period;
+			this_thread::sleep_until(next);
+		}
+	});
+
+	char byte = 1;
+	if (write(readyFd, &byte, 1) != 1)
+		cerr << "Unable to tell the bench the server is up" << endl;
+	runOpponent(quitFd);
+
+	udp.stop();
+	simulating = false;
+	simulation.join();
+	srv.close_sessions();
+	srv.stop();
+}
+
+// plays the OCULUS player's render loop for a while, returns the frames it ran
+static long long runFrames(NetworkClient & network, ScriptedDevice & device, long long frame, double seconds)
+{
+	TrackedPoses tracked;
+	const chrono::nanoseconds period(1000000000 / FRAME_RATE);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point next = start;
+	long long frames = 0;
+	while (secondsSince(start) < seconds)
+	{
+		device.poll(frame + frames, tracked);
+		s_PlayerState local;
+		local.head = packPose(serializePose(tracked.head));
+		local.hand = packPose(serializePose(tracked.hand));
+		network.sendPlayerState(local);
+
+		s_WorldSnapshot snapshot;
+		while (network.receiveSnapshot(snapshot))
+		{
+			keep(deserializePose(unpackPose(snapshot.heads[LEAP])));
+			keep(deserializePose(unpackPose(snapshot.hands[LEAP])));
+			keep(deserializeBall(snapshot.ball, snapshot.lastPlayer));
+		}
+		++frames;
+
+		next += period;
+		this_thread::sleep_until(next);
+	}
+	return frames;
+}
+
+// one client on the given transport from joining to leaving, returns whether it got to
+// play and reports what its steady frames allocated
+static bool benchTransport(const string & name, bool useUdp, uint64_t & counted)
+{
+	ScriptedDevice device(OCULUS, FRAME_RATE);
+	TrackedPoses tracked;
+	device.poll(0, tracked);
+	unique_ptr<NetworkClient> network(new NetworkClient(DEFAULT_ROOM, OCULUS, useUdp));
+	network->start(serializePose(tracked.head), serializePose(tracked.hand));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	while (!network->isReady() && !network->hasFailed() && secondsSince(start) < READY_TIMEOUT_SECONDS)
+		this_thread::sleep_for(chrono::milliseconds(10));
+	if (!network->isReady())
+	{
+		cerr << name << " client never got to play" << endl;
+		return false;
+	}
+
+	// the first frames size the reused buffers
+	long long frame = runFrames(*network, device, 0, WARMUP_SECONDS);
+
+	renderThread = true;
+	allocations = 0;
+	renderAllocations = 0;
+	counting = true;
+	long long frames = runFrames(*network, device, frame, MEASURE_SECONDS);
+	counting = false;
+	renderThread = false;
+
+	network->stop();
+	counted = allocations;
+	report(name + " frames", (double)frames, "");
+	report(name + " render thread allocations per frame", (double)renderAllocations / frames, "");
+	report(name + " network thread allocations per frame", (double)(allocations - renderAllocations) / frames, "");
+	return true;
+}
+
+// the ball matrix as getBallPose answers it, packed into a reused buffer
+static uint64_t benchBallMatrix()
+{
+	BallState ball;
+	resetBall(ball);
+	RPCLIB_MSGPACK::sbuffer buffer;
+	RPCLIB_MSGPACK::pack(buffer, serializeMat(ballMatrix(ball)));
+
+	allocations = 0;
+	counting = true;
+	for (int i = 0; i < BALL_PACKS; ++i)
+	{
+		moveBall(ball, TICK_SECONDS);
+		buffer.clear();
+		RPCLIB_MSGPACK::pack(buffer, serializeMat(ballMatrix(ball)));
+	}
+	counting = false;
+	report("ball matrix pack allocations", (double)allocations, "");
+	return allocations;
+}
+
+int main()
+{
+	uint64_t ballAllocations = benchBallMatrix();
+
+	// nothing is running yet, so the child starts with a clean copy of the process
+	int ready[2], quit[2];
+	if (pipe(ready) != 0 || pipe(quit) != 0)
+	{
+		cerr << "Unable to make pipes for the server process" << endl;
+		return 1;
+	}
+	pid_t server = fork();
+	if (server < 0)
+	{
+		cerr << "Unable to start the server process" << endl;
+		return 1;
+	}
+	if (server == 0)
+	{
+		close(ready[0]);
+		close(quit[1]);
+		fcntl(quit[0], F_SETFL, O_NONBLOCK);
+		runServer(ready[1], quit[0]);
+		_exit(0);
+	}
+	close(ready[1]);
+	close(quit[0]);
+	char byte;
+	bool started = read(ready[0], &byte, 1) == 1;
+
+	uint64_t udpAllocations = 0, rpcAllocations = 0;
+	bool played = started &&
+		benchTransport("udp", true, udpAllocations) &&
+		benchTransport("rpc", false, rpcAllocations);
+
+	close(quit[1]);
+	waitpid(server, NULL, 0);
+	return (played && ballAllocations == 0 && udpAllocations == 0) ? 0 : 1;
+}
+#else
+int main()
+{
+	cout << "Allocations are only counted with glibc" << endl;
+	return 0;
+}
+#endif
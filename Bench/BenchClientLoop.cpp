@@ -0,0 +1,323 @@
+#include <rpc/server.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstdlib>
+
+#include "Bench.h"
+#include "SerializablePose.h"
+#include "Handlers.h"
+#include "ServerBinder.h"
+#include "UdpServer.h"
+#include "NetworkClient.h"
+#include "SnapshotBuffer.h"
+#include "InputDevice.h"
+using namespace std;
+
+// the client's update loop for both players without a headset, a Leap or a window: each
+// polls a scripted or recorded device, hands its state to the network thread, applies the
+// snapshots that came back and samples the other player from its jitter buffer. the server
+// runs in this process with its simulation, so paddle hits happen like in a real match.
+// a match is played over each transport, once as is and once with everything the server
+// sends held back by --latency: rpc answers wait in the handlers, udp snapshots in the
+// server's socket. no frame waits on the network thread, so the run fails if the 99th
+// percentile frame time grows by MAX_P99_GROWTH_US or more on either transport.
+// --udp-drop and --udp-delay impair the server's snapshots like netem would, and each
+// player reports how old the poses in its snapshots were when they arrived.
+
+#define DEFAULT_FRAME_RATE 90
+#define DEFAULT_SECONDS 10
+#define DEFAULT_LATENCY_MS 100
+
+// well under one frame at 90 Hz, any wait on the network would blow through it
+#define MAX_P99_GROWTH_US 1000.0
+
+#define SERVER_WORKERS 3
+
+// one side of the match as the client sees it
+struct HeadlessPlayer
+{
+	int player;
+	unique_ptr<InputDevice> device;
+	unique_ptr<NetworkClient> network;
+	SnapshotBuffer remotePoses;
+	TrackedPoses tracked;
+	BallState ball;
+	uint64_t snapshots;
+	int hits;
+
+	// server clock at arrival minus the snapshot's stamp, both in this process
+	LatencySamples poseAges;
+};
+
+static atomic<bool> simulating(true);
+
+// how long the stand-in server holds back every answer, in milliseconds
+static atomic<int> injectedLatencyMs(0);
+
+static void runSimulation()
+{
+	const chrono::nanoseconds period(1000000000 / TICK_RATE);
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	while (simulating)
+	{
+		rooms.tick(TICK_SECONDS);
+		next += period;
+		this_thread::sleep_until(next);
+	}
+}
+
+// what ExampleApp::update and syncWorld do per frame, minus the drawing
+static void updatePlayer(HeadlessPlayer & p, long long frame, double now)
+{
+	p.device->poll(frame, p.tracked);
+
+	s_PlayerState local;
+	local.head = packPose(serializePose(p.tracked.head));
+	local.hand = packPose(serializePose(p.tracked.hand));
+	p.network->sendPlayerState(local);
+
+	int remote = (p.player == OCULUS) ? LEAP : OCULUS;
+	s_WorldSnapshot snapshot;
+	while (p.network->receiveSnapshot(snapshot))
+	{
+		p.remotePoses.push(snapshot.serverTimeMs / 1000.0,
+			deserializePose(unpackPose(snapshot.heads[remote])),
+			deserializePose(unpackPose(snapshot.hands[remote])),
+			deserializeBall(snapshot.ball, snapshot.lastPlayer),
+			now);
+		++p.snapshots;
+		p.poseAges.add(chrono::milliseconds(serverTimeMs() - snapshot.serverTimeMs));
+	}
+
+	ovrPosef remoteHead, remoteHand;
+	p.remotePoses.sample(now, remoteHead, remoteHand);
+	keep(remoteHand);
+
+	BallState drawn;
+	if (p.remotePoses.sampleBall(now, drawn))
+	{
+		if (drawn.lastPlayer != 0 && drawn.lastPlayer != p.ball.lastPlayer)
+			++p.hits;
+		p.ball = drawn;
+	}
+}
+
+// runs both players' frames for the given time, reports how they went under the
+// given name and returns the 99th percentile frame time in microseconds
+static double runFrames(HeadlessPlayer players[2], const string & name, double rate, double seconds)
+{
+	LatencySamples frameTimes;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point next = start;
+	long long frame = 0;
+	while (secondsSince(start) < seconds)
+	{
+		chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+		double now = secondsSince(start);
+		for (int i = OCULUS; i <= LEAP; ++i)
+			updatePlayer(players[i], frame, now);
+		frameTimes.add(chrono::steady_clock::now() - frameStart);
+		++frame;
+
+		if (rate > 0.0)
+		{
+			next += chrono::nanoseconds((long long)(1e9 / rate));
+			this_thread::sleep_until(next);
+		}
+	}
+	double elapsed = secondsSince(start);
+
+	report(name + " frames", frame / elapsed, "frames/s");
+	reportLatency(name + " update both players", frameTimes);
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		string player = (i == OCULUS) ? " oculus" : " leap";
+		report(name + player + " snapshots", players[i].snapshots / elapsed, "/s");
+		report(name + player + " ball hits seen", players[i].hits, "");
+		reportLatency(name + player + " pose age", players[i].poseAges);
+		players[i].snapshots = 0;
+		players[i].hits = 0;
+		players[i].poseAges = LatencySamples();
+	}
+	return frameTimes.percentile(0.99);
+}
+
+// one match over rpc or udp from joining to leaving the default room, as is and then
+// with latencyMs held back. returns false if the players never got to play or the frame
+// time didn't stay flat
+static bool runMatch(HeadlessPlayer players[2], bool useUdp, UdpServer & udp, const UdpImpairment & impairment,
+	double rate, double seconds, int latencyMs)
+{
+	const string transport = useUdp ? "udp" : "rpc";
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		players[i].device->poll(0, players[i].tracked);
+		players[i].network.reset(new NetworkClient(DEFAULT_ROOM, i, useUdp));
+		players[i].network->start(serializePose(players[i].tracked.head), serializePose(players[i].tracked.hand));
+	}
+	bool started = true;
+	while (started && (!players[OCULUS].network->isReady() || !players[LEAP].network->isReady()))
+	{
+		for (int i = OCULUS; i <= LEAP; ++i)
+		{
+			if (players[i].network->hasFailed())
+			{
+				cerr << transport << " player " << i << " could not start: " << players[i].network->failure() << endl;
+				started = false;
+			}
+		}
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	// a frame that waited on the network shows up in the tail of the second run
+	bool flat = true;
+	if (started)
+	{
+		double p99 = runFrames(players, transport + " no latency", rate, seconds);
+		if (latencyMs > 0)
+		{
+			// the udp socket is only reconfigured while its worker is stopped
+			UdpImpairment delayed = impairment;
+			delayed.delayMs += latencyMs;
+			injectedLatencyMs = latencyMs;
+			if (useUdp)
+			{
+				udp.stop();
+				udp.setImpairment(delayed);
+				udp.start(SERVER_UDP_PORT);
+			}
+
+			double delayedP99 = runFrames(players, transport + " " + to_string(latencyMs) + " ms latency", rate, seconds);
+			report(transport + " p99 frame time change", delayedP99 - p99, "us");
+			flat = delayedP99 - p99 < MAX_P99_GROWTH_US;
+
+			injectedLatencyMs = 0;
+			if (useUdp)
+			{
+				udp.stop();
+				udp.setImpairment(impairment);
+				udp.start(SERVER_UDP_PORT);
+			}
+		}
+	}
+
+	// the clients leave their seats, so the next match can take them
+	for (int i = OCULUS; i <= LEAP; ++i)
+		players[i].network.reset();
+	return started && flat;
+}
+
+void printUsage(const char* program)
+{
+	cout << "Usage: " << program << " [--rate HZ] [--seconds S] [--latency MS] [--udp-drop RATE] [--udp-delay MS]"
+		<< " [--input PATH] [--record-input PATH] [--rpc | --udp]" << endl;
+	cout << "  --rate 0 runs frames back to back, --input plays a recording for the OCULUS player" << endl;
+	cout << "  --latency holds back everything the server sends in the second run of each match, 0 skips that run" << endl;
+	cout << "  --udp-drop and --udp-delay impair the snapshots the server sends over udp" << endl;
+	cout << "  --rpc or --udp only plays the match over that transport, both are played by default" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	double rate = DEFAULT_FRAME_RATE;
+	double seconds = DEFAULT_SECONDS;
+	int latencyMs = DEFAULT_LATENCY_MS;
+	string inputFile, recordFile;
+	bool overRpc = true, overUdp = true;
+	UdpImpairment impairment = { 0.0f, 0, 0 };
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--rate" && i + 1 < argc)
+			rate = max(0.0, atof(argv[++i]));
+		else if (arg == "--seconds" && i + 1 < argc)
+			seconds = max(0.1, atof(argv[++i]));
+		else if (arg == "--latency" && i + 1 < argc)
+			latencyMs = max(0, atoi(argv[++i]));
+		else if (arg == "--udp-drop" && i + 1 < argc)
+			impairment.dropRate = (float)atof(argv[++i]);
+		else if (arg == "--udp-delay" && i + 1 < argc)
+			impairment.delayMs = max(0, atoi(argv[++i]));
+		else if (arg == "--input" && i + 1 < argc)
+			inputFile = argv[++i];
+		else if (arg == "--record-input" && i + 1 < argc)
+			recordFile = argv[++i];
+		else if (arg == "--rpc")
+			overUdp = false;
+		else if (arg == "--udp")
+			overRpc = false;
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// the scripted devices run on the frame number, so the poses follow the chosen rate.
+	// files are opened before anything starts so a bad path leaves nothing to stop
+	double scriptRate = (rate > 0.0) ? rate : DEFAULT_FRAME_RATE;
+	unique_ptr<InputDevice> recorded;
+	HeadlessPlayer players[2];
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		players[i].player = i;
+		players[i].device.reset(new ScriptedDevice(i, scriptRate));
+		players[i].snapshots = 0;
+		players[i].hits = 0;
+		resetBall(players[i].ball);
+	}
+	if (!inputFile.empty())
+	{
+		RecordedDevice * device = new RecordedDevice();
+		players[OCULUS].device.reset(device);
+		if (!device->open(inputFile))
+		{
+			cerr << "Unable to read input from " << inputFile << endl;
+			return 1;
+		}
+	}
+	if (!recordFile.empty())
+	{
+		// the recorder passes the OCULUS player's device through, keeping it alive
+		recorded = move(players[OCULUS].device);
+		InputRecorder * recorder = new InputRecorder(*recorded);
+		players[OCULUS].device.reset(recorder);
+		if (!recorder->open(recordFile))
+		{
+			cerr << "Unable to record input to " << recordFile << endl;
+			return 1;
+		}
+	}
+
+	// the server the clients connect to, bound like the real one
+	rpc::server srv(SERVER_IP, SERVER_PORT);
+	ServerBinder binder(srv, &injectedLatencyMs);
+	bindHandlers(binder);
+	binder.bindMethodTable();
+	setLongPollCapacity(SERVER_WORKERS - 1);
+	rooms.create();
+	srv.async_run(SERVER_WORKERS);
+	thread simThread(runSimulation);
+	UdpServer udp(rooms);
+	udp.setImpairment(impairment);
+	if (overUdp && !udp.start(SERVER_UDP_PORT))
+	{
+		cerr << "Unable to open udp port " << SERVER_UDP_PORT << ", only playing over rpc" << endl;
+		overUdp = false;
+	}
+
+	bool passed = true;
+	if (overRpc)
+		passed = runMatch(players, false, udp, impairment, rate, seconds, latencyMs) && passed;
+	if (overUdp)
+		passed = runMatch(players, true, udp, impairment, rate, seconds, latencyMs) && passed;
+
+	udp.stop();
+	simulating = false;
+	simThread.join();
+	srv.close_sessions();
+	srv.stop();
+	return passed ? 0 : 1;
+}
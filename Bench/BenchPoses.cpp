@@ -0,0 +1,413 @@
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Bench.h"
+#include "SerializablePose.h"
+#include "SnapshotDelta.h"
+#include "Metrics.h"
+#include "Handlers.h"
+#include "RecordReplay.h"
+using namespace std;
+
+// what the poses cost on the wire: packing time, bytes per frame for each way of
+// sending them, and the snapshot delta codec against full snapshots. the map encoding
+// poses and matrices had before the compact format is kept here as the baseline.
+// --log replays a match recorded with Server --record and reports the bandwidth its
+// snapshots take as full msgpack and as deltas.
+
+#define ITERATIONS 2000000
+#define SNAPSHOTS 20000
+
+// one step of the quantized position, and of a quantized rotation component
+#define POSITION_TOLERANCE (ARENA_EXTENT / 32767.0f)
+#define ROTATION_TOLERANCE (2.0f * QUAT_COMPONENT_RANGE / 1023.0f)
+
+// a pose moving along a smooth path, like a tracked head or hand
+static s_Pose movingPose(int i, float speed)
+{
+	float t = i * speed;
+	s_Pose pose;
+	pose.pos_x = 0.5f * sinf(t);
+	pose.pos_y = 1.4f + 0.1f * sinf(t * 0.7f);
+	pose.pos_z = -0.3f + 0.2f * cosf(t);
+	pose.rot_x = 0.0f;
+	pose.rot_y = sinf(t * 0.25f);
+	pose.rot_z = 0.0f;
+	pose.rot_w = cosf(t * 0.25f);
+	return pose;
+}
+
+// s_Pose as it used to be sent, with every field name in every message
+struct MapPose
+{
+	float pos_x, pos_y, pos_z;
+	float rot_x, rot_y, rot_z, rot_w;
+
+	MSGPACK_DEFINE_MAP(pos_x, pos_y, pos_z,
+		rot_x, rot_y, rot_z, rot_w);
+};
+
+// s_Mat as it used to be, a map holding a heap vector
+struct MapMat
+{
+	vector<float> values;
+	MSGPACK_DEFINE_MAP(values);
+};
+
+static MapPose mapPose(const s_Pose & pose)
+{
+	MapPose ret = { pose.pos_x, pose.pos_y, pose.pos_z, pose.rot_x, pose.rot_y, pose.rot_z, pose.rot_w };
+	return ret;
+}
+
+// the old serializeMat, through a stack array into a fresh vector
+static MapMat mapSerializeMat(const glm::mat4 & mat)
+{
+	float convertedMat[16] = { 0.0f };
+	const float *pSource = (const float*)glm::value_ptr(mat);
+	for (int i = 0; i < 16; ++i)
+		convertedMat[i] = pSource[i];
+
+	MapMat ret;
+	ret.values = vector<float>(convertedMat, convertedMat + 16);
+	return ret;
+}
+
+// packs values round robin into a reused buffer
+template <typename T>
+double packNs(const vector<T> & values)
+{
+	RPCLIB_MSGPACK::sbuffer buffer;
+	return nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		buffer.clear();
+		RPCLIB_MSGPACK::pack(buffer, values[i % values.size()]);
+		keep(buffer.size());
+	});
+}
+
+// unpacks and converts values packed beforehand
+template <typename T>
+double unpackNs(const vector<T> & values)
+{
+	vector<string> packed;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		RPCLIB_MSGPACK::sbuffer buffer;
+		RPCLIB_MSGPACK::pack(buffer, values[i]);
+		packed.push_back(string(buffer.data(), buffer.size()));
+	}
+	return nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		const string & data = packed[i % packed.size()];
+		RPCLIB_MSGPACK::object_handle handle = RPCLIB_MSGPACK::unpack(data.data(), data.size());
+		T value;
+		handle.get().convert(value);
+		keep(packedSize(value));
+	});
+}
+
+// collects the names of the bound methods in the order the server numbers them
+struct NameBinder
+{
+	vector<string> names;
+
+	template <typename F>
+	void bind(const string & name, F)
+	{
+		names.push_back(name);
+	}
+};
+
+// the compact id the server gives a method
+static string idOf(const string & name)
+{
+	NameBinder binder;
+	bindHandlers(binder);
+	for (size_t i = 0; i < binder.names.size(); ++i)
+	{
+		if (binder.names[i] == name)
+			return methodId((int)i);
+	}
+	return name;
+}
+
+// rpc notification as it goes on the wire: type, method and the argument array
+template <typename... Args>
+size_t notificationSize(const string & method, Args... args)
+{
+	return packedSize(make_tuple(2, method, make_tuple(args...)));
+}
+
+// the poses a world was built from, before they were quantized
+struct SourcePoses
+{
+	s_Pose heads[2];
+	s_Pose hands[2];
+};
+
+// world as the server would publish it TICK_RATE times a second with both players moving
+static s_WorldSnapshot movingWorld(int i, SourcePoses & source)
+{
+	s_WorldSnapshot snapshot = s_WorldSnapshot();
+	snapshot.tick = (unsigned int)i * 3;
+	snapshot.changed = true;
+	snapshot.serverTimeMs = (unsigned int)i * 8;
+	for (int player = 0; player < 2; ++player)
+	{
+		source.heads[player] = movingPose(i + player * 100, 0.01f);
+		source.hands[player] = movingPose(i + player * 100, 0.05f);
+		snapshot.heads[player] = packPose(source.heads[player]);
+		snapshot.hands[player] = packPose(source.hands[player]);
+	}
+	snapshot.ball.pos_x = sinf(i * 0.02f);
+	snapshot.ball.pos_y = 1.2f;
+	snapshot.ball.pos_z = cosf(i * 0.02f) * 2.0f;
+	snapshot.ball.vel_x = cosf(i * 0.02f);
+	snapshot.ball.vel_y = 0.0f;
+	snapshot.ball.vel_z = -sinf(i * 0.02f) * 2.0f;
+	snapshot.ball.tick = (unsigned int)i;
+	snapshot.lastPlayer = 1;
+	return snapshot;
+}
+
+// a decoded pose within one quantization step of where it started, q and -q are the same rotation
+static bool closePose(const s_PackedPose & decoded, const s_Pose & source)
+{
+	s_Pose pose = unpackPose(decoded);
+	if (fabsf(pose.pos_x - source.pos_x) > POSITION_TOLERANCE ||
+		fabsf(pose.pos_y - source.pos_y) > POSITION_TOLERANCE ||
+		fabsf(pose.pos_z - source.pos_z) > POSITION_TOLERANCE)
+		return false;
+
+	float dot = pose.rot_x * source.rot_x + pose.rot_y * source.rot_y + pose.rot_z * source.rot_z + pose.rot_w * source.rot_w;
+	float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+	return fabsf(sign * pose.rot_x - source.rot_x) <= ROTATION_TOLERANCE &&
+		fabsf(sign * pose.rot_y - source.rot_y) <= ROTATION_TOLERANCE &&
+		fabsf(sign * pose.rot_z - source.rot_z) <= ROTATION_TOLERANCE &&
+		fabsf(sign * pose.rot_w - source.rot_w) <= ROTATION_TOLERANCE;
+}
+
+// every field of a decoded snapshot against the one encoded, the poses against what
+// they were quantized from and everything else exactly
+static bool sameSnapshot(const s_WorldSnapshot & decoded, const s_WorldSnapshot & expected, const SourcePoses & source)
+{
+	if (decoded.tick != expected.tick || decoded.changed != expected.changed ||
+		decoded.serverTimeMs != expected.serverTimeMs || decoded.lastPlayer != expected.lastPlayer)
+		return false;
+
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		if (!closePose(decoded.heads[i], source.heads[i]) || !closePose(decoded.hands[i], source.hands[i]))
+			return false;
+	}
+
+	const s_BallState & a = decoded.ball;
+	const s_BallState & b = expected.ball;
+	return a.pos_x == b.pos_x && a.pos_y == b.pos_y && a.pos_z == b.pos_z &&
+		a.vel_x == b.vel_x && a.vel_y == b.vel_y && a.vel_z == b.vel_z && a.tick == b.tick;
+}
+
+// the snapshots every room of a recorded match pushed, as full msgpack answers and as
+// deltas against the previous one the way the udp channel sends them to an acking
+// player. every delta is decoded again and checked
+static int benchRecordedBandwidth(const string & path)
+{
+	RecordReplay replay;
+	if (!replay.open(path))
+	{
+		cerr << "Unable to read " << path << endl;
+		return 1;
+	}
+
+	vector<unsigned int> seenTick(MAX_ROOMS, 0);
+	vector<s_WorldSnapshot> previous(MAX_ROOMS, s_WorldSnapshot());
+	uint64_t snapshots = 0, fullBytes = 0, deltaBytes = 0, keyframeBytes = 0;
+	int mismatches = 0;
+	vector<char> delta;
+
+	replay.run(0.0, [&]() {
+		for (int i = 0; i < MAX_ROOMS; ++i)
+		{
+			Room * room = rooms.find(i);
+			if (!room || room->pushedTick == seenTick[i])
+				continue;
+			seenTick[i] = room->pushedTick;
+
+			s_WorldSnapshot snapshot = room->snapshot(0);
+			fullBytes += packedSize(snapshot);
+
+			delta.clear();
+			{
+				BitWriter writer(delta);
+				encodeSnapshotDelta(writer, snapshot, s_WorldSnapshot());
+			}
+			keyframeBytes += delta.size();
+
+			delta.clear();
+			{
+				BitWriter writer(delta);
+				encodeSnapshotDelta(writer, snapshot, previous[i]);
+			}
+			deltaBytes += delta.size();
+
+			SourcePoses source;
+			for (int player = OCULUS; player <= LEAP; ++player)
+			{
+				source.heads[player] = unpackPose(snapshot.heads[player]);
+				source.hands[player] = unpackPose(snapshot.hands[player]);
+			}
+			BitReader reader(delta.data(), delta.size());
+			s_WorldSnapshot decoded;
+			if (!decodeSnapshotDelta(reader, decoded, previous[i]) || !sameSnapshot(decoded, snapshot, source))
+				++mismatches;
+
+			previous[i] = snapshot;
+			++snapshots;
+		}
+	});
+
+	if (snapshots == 0)
+	{
+		cerr << path << " pushed no snapshots, was anyone playing?" << endl;
+		return 1;
+	}
+
+	// each snapshot goes to both players of its room
+	double seconds = replay.durationNs / 1e9;
+	report("recorded calls", (double)replay.calls, "");
+	report("recorded seconds", seconds, "s");
+	report("recorded snapshots", (double)snapshots, "");
+	report("recorded snapshot msgpack", (double)fullBytes / snapshots, "bytes");
+	report("recorded snapshot keyframe", (double)keyframeBytes / snapshots, "bytes");
+	report("recorded snapshot delta", (double)deltaBytes / snapshots, "bytes");
+	if (seconds > 0.0)
+	{
+		report("recorded msgpack per player", fullBytes * 8 / seconds / 1000.0, "kbit/s");
+		report("recorded delta per player", deltaBytes * 8 / seconds / 1000.0, "kbit/s");
+	}
+	report("recorded decode mismatches", mismatches, "");
+	return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	string logPath;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--log" && i + 1 < argc)
+			logPath = argv[++i];
+		else
+		{
+			cout << "Usage: " << argv[0] << " [--log PATH]" << endl;
+			cout << "  --log replays a match recorded with Server --record for its snapshot bandwidth" << endl;
+			return 1;
+		}
+	}
+
+	vector<s_Pose> poses;
+	for (int i = 0; i < 1024; ++i)
+		poses.push_back(movingPose(i, 0.05f));
+
+	report("packPose", nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		keep(packPose(poses[i & 1023]));
+	}), "ns");
+
+	vector<s_PackedPose> packed;
+	for (size_t i = 0; i < poses.size(); ++i)
+		packed.push_back(packPose(poses[i]));
+	report("unpackPose", nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		keep(unpackPose(packed[i & 1023]));
+	}), "ns");
+
+	// one pose through msgpack in each encoding
+	vector<MapPose> mapPoses;
+	for (size_t i = 0; i < poses.size(); ++i)
+		mapPoses.push_back(mapPose(poses[i]));
+	report("pose map (old)", (double)packedSize(mapPoses[0]), "bytes");
+	report("pose array", (double)packedSize(poses[0]), "bytes");
+	report("pose packed", (double)packedSize(packed[0]), "bytes");
+	report("pack pose map (old)", packNs(mapPoses), "ns");
+	report("pack pose array", packNs(poses), "ns");
+	report("pack pose packed", packNs(packed), "ns");
+	report("unpack pose map (old)", unpackNs(mapPoses), "ns");
+	report("unpack pose array", unpackNs(poses), "ns");
+	report("unpack pose packed", unpackNs(packed), "ns");
+
+	// the ball matrix, serialized and packed the old way and the current way
+	glm::mat4 matrix(1.0f);
+	report("matrix map (old)", (double)packedSize(mapSerializeMat(matrix)), "bytes");
+	report("matrix array", (double)packedSize(serializeMat(matrix)), "bytes");
+	RPCLIB_MSGPACK::sbuffer matrixBuffer;
+	report("serializeMat + pack map (old)", nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		matrix[3][0] = (float)(i & 1023);
+		matrixBuffer.clear();
+		RPCLIB_MSGPACK::pack(matrixBuffer, mapSerializeMat(matrix));
+		keep(matrixBuffer.size());
+	}), "ns");
+	report("serializeMat + pack array", nsPerIteration(ITERATIONS, [&](uint64_t i) {
+		matrix[3][0] = (float)(i & 1023);
+		matrixBuffer.clear();
+		RPCLIB_MSGPACK::pack(matrixBuffer, serializeMat(matrix));
+		keep(matrixBuffer.size());
+	}), "ns");
+
+	// one player's upload per frame, the way each client generation sent it
+	s_Pose head = poses[0], hand = poses[1];
+	s_PlayerState state;
+	state.head = packPose(head);
+	state.hand = packPose(hand);
+	report("setPose x2 by name, map (old)", (double)(notificationSize("setPose", OCULUS, HEAD, mapPose(head))
+		+ notificationSize("setPose", OCULUS, HAND, mapPose(hand))), "bytes/frame");
+	report("setPose x2 by name", (double)(notificationSize("setPose", 0, OCULUS, HEAD, head)
+		+ notificationSize("setPose", 0, OCULUS, HAND, hand)), "bytes/frame");
+	report("pushPlayerState by name", (double)notificationSize("pushPlayerState", 0, OCULUS, 1u, state), "bytes/frame");
+	report("pushPlayerState by id", (double)notificationSize(idOf("pushPlayerState"), 0, OCULUS, 1u, state), "bytes/frame");
+
+	// the delta codec on a synthetic world, the bandwidth that matters comes from --log
+	vector<s_WorldSnapshot> world;
+	vector<SourcePoses> sources(SNAPSHOTS);
+	for (int i = 0; i < SNAPSHOTS; ++i)
+		world.push_back(movingWorld(i, sources[i]));
+
+	vector<char> delta;
+	double encodeNs = nsPerIteration(world.size() - 1, [&](uint64_t i) {
+		delta.clear();
+		BitWriter writer(delta);
+		encodeSnapshotDelta(writer, world[i + 1], world[i]);
+		writer.flush();
+		keep(delta.size());
+	});
+	report("encodeSnapshotDelta", encodeNs, "ns");
+
+	vector<vector<char>> deltas(world.size() - 1);
+	for (size_t i = 0; i + 1 < world.size(); ++i)
+	{
+		BitWriter writer(deltas[i]);
+		encodeSnapshotDelta(writer, world[i + 1], world[i]);
+	}
+	double decodeNs = nsPerIteration(deltas.size(), [&](uint64_t i) {
+		BitReader reader(deltas[i].data(), deltas[i].size());
+		s_WorldSnapshot decoded;
+		keep(decodeSnapshotDelta(reader, decoded, world[i]));
+		keep(decoded);
+	});
+	report("decodeSnapshotDelta", decodeNs, "ns");
+
+	// checked outside the timing, every field of every snapshot
+	int mismatches = 0;
+	for (size_t i = 0; i < deltas.size(); ++i)
+	{
+		BitReader reader(deltas[i].data(), deltas[i].size());
+		s_WorldSnapshot decoded;
+		if (!decodeSnapshotDelta(reader, decoded, world[i]) || !sameSnapshot(decoded, world[i + 1], sources[i + 1]))
+			++mismatches;
+	}
+	report("decode mismatches", mismatches, "");
+	if (mismatches != 0)
+		return 1;
+
+	return logPath.empty() ? 0 : benchRecordedBandwidth(logPath);
+}
@@ -0,0 +1,364 @@
+#include <rpc/server.h>
+#include <rpc/client.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef RPCLIB_FROM_SOURCE
+#include <rpc/detail/buffer_pool.h>
+#endif
+
+#include "Bench.h"
+#include "SerializablePose.h"
+#include "Handlers.h"
+#include "ProcessStats.h"
+#include "ServerBinder.h"
+using namespace std;
+
+// the rpc path end to end over loopback, with the server's own handlers running in this
+// process: call latency by name and by compact id, notifications against calls, getPose
+// throughput from 1 to SWEEP_THREADS clients at once, the cpu one player burns waiting
+// in the lobby, and what idle sessions cost the server in memory. the clients of the idle
+// sessions run in a process of their own, so only the server's end is measured. the run
+// fails if an idle session goes over its memory target, or, with rpclib built from
+// source, if the buffers it holds do. client and server share the machine, so these are
+// for comparing builds against each other, not absolute capacity.
+
+#define BENCH_PORT 8095
+// one per client of the getPose sweep, so the server isn't what caps it
+#define BENCH_WORKERS 8
+#define SWEEP_THREADS 8
+#define SWEEP_SECONDS 2
+#define CALLS 20000
+#define DEFAULT_SESSIONS 1000
+
+// most resident memory an idle session may add to the server
+#define IDLE_SESSION_TARGET_KB 64
+// most an idle session may hold in its read buffer and its share of the response buffers
+#define IDLE_BUFFER_TARGET_KB 8
+#define DEFAULT_LOBBY_SECONDS 5
+#define LOBBY_WAIT_MS 1000
+
+// names of the bound methods, indexed by compact id
+static vector<string> methodNames;
+
+static string idOf(const string & name)
+{
+	for (size_t i = 0; i < methodNames.size(); ++i)
+	{
+		if (methodNames[i] == name)
+			return methodId((int)i);
+	}
+	return name;
+}
+
+static void benchCalls(rpc::client & client, const string & label, const string & method)
+{
+	LatencySamples samples;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < CALLS; ++i)
+	{
+		chrono::steady_clock::time_point callStart = chrono::steady_clock::now();
+		client.call(method, DEFAULT_ROOM, OCULUS, 0u).as<s_WorldSnapshot>();
+		samples.add(chrono::steady_clock::now() - callStart);
+	}
+	report(label, CALLS / secondsSince(start), "calls/s");
+	reportLatency(label, samples);
+}
+
+// getPose calls per second with 1 to SWEEP_THREADS clients calling at once, each on a
+// session and thread of its own, the path that dispatches a call and packs its result
+static void benchGetPoseThreads(uint16_t port)
+{
+	const string getPose = idOf("getPose");
+	for (int threads = 1; threads <= SWEEP_THREADS; ++threads)
+	{
+		vector<unique_ptr<rpc::client>> clients;
+		for (int i = 0; i < threads; ++i)
+		{
+			clients.emplace_back(new rpc::client("127.0.0.1", port));
+			clients.back()->call(getPose, DEFAULT_ROOM, OCULUS, HEAD);
+		}
+
+		atomic<uint64_t> calls(0);
+		vector<thread> callers;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int i = 0; i < threads; ++i)
+		{
+			callers.emplace_back([&, i]() {
+				uint64_t made = 0;
+				while (secondsSince(start) < SWEEP_SECONDS)
+				{
+					keep(clients[i]->call(getPose, DEFAULT_ROOM, OCULUS, HEAD).as<s_Pose>());
+					++made;
+				}
+				calls += made;
+			});
+		}
+		for (size_t i = 0; i < callers.size(); ++i)
+			callers[i].join();
+		report("getPose with " + to_string(threads) + " threads", calls / secondsSince(start), "calls/s");
+	}
+}
+
+// player state uploads as notifications against the same upload as a call, a call at
+// the end makes sure the server got through every notification before the clock stops
+static void benchUploads(rpc::client & client)
+{
+	s_Pose pose = { 0.1f, 1.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f };
+	s_PlayerState state;
+	state.head = packPose(pose);
+	state.hand = packPose(pose);
+	const string push = idOf("pushPlayerState");
+
+	unsigned int sequence = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < CALLS; ++i)
+		client.send(push, DEFAULT_ROOM, OCULUS, ++sequence, state);
+	client.call(idOf("getWorldSnapshot"), DEFAULT_ROOM, OCULUS, 0u);
+	report("pushPlayerState send", CALLS / secondsSince(start), "calls/s");
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < CALLS; ++i)
+		client.call(push, DEFAULT_ROOM, OCULUS, ++sequence, state);
+	report("pushPlayerState call", CALLS / secondsSince(start), "calls/s");
+}
+
+// one ready player whose opponent never shows up, first asking checkConnection back to
+// back like the old client did, then parked in waitForPeers. the client blocks in both,
+// so the process cpu time is the server's, reported as a share of one core
+static void benchLobby(rpc::client & client, double seconds)
+{
+	int room = client.call(idOf("createRoom")).as<int>();
+	client.call(idOf("joinRoom"), room, OCULUS);
+	client.call(idOf("oculusReady"), room);
+
+	const string checkConnection = idOf("checkConnection");
+	double cpuStart = processCpuSeconds();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long long calls = 0;
+	while (secondsSince(start) < seconds)
+	{
+		client.call(checkConnection, room);
+		++calls;
+	}
+	double elapsed = secondsSince(start);
+	report("lobby polling checkConnection cpu", (processCpuSeconds() - cpuStart) / elapsed * 100.0, "% of a core");
+	report("lobby polling checkConnection", calls / elapsed, "calls/s");
+
+	const string waitForPeers = idOf("waitForPeers");
+	cpuStart = processCpuSeconds();
+	start = chrono::steady_clock::now();
+	calls = 0;
+	while (secondsSince(start) < seconds)
+	{
+		client.call(waitForPeers, room, OCULUS, LOBBY_WAIT_MS);
+		++calls;
+	}
+	elapsed = secondsSince(start);
+	report("lobby parked in waitForPeers cpu", (processCpuSeconds() - cpuStart) / elapsed * 100.0, "% of a core");
+	report("lobby parked in waitForPeers", calls / elapsed, "calls/s");
+
+	client.call(idOf("closeRoom"), room);
+}
+
+// reports what the sessions opened between the two readings of resident memory cost,
+// returns false if one went over its targets
+static bool reportIdleSessions(size_t before, size_t after, int sessions)
+{
+	if (before == 0 || after == 0)
+	{
+		cout << "Resident memory is unknown on this platform, not checking idle sessions" << endl;
+		return true;
+	}
+
+	size_t grown = (after > before) ? after - before : 0;
+	double perSession = grown / 1024.0 / sessions;
+	report(to_string(sessions) + " idle sessions", grown / (1024.0 * 1024.0), "MB");
+	report("idle session", perSession, "KB");
+	report("idle session target", IDLE_SESSION_TARGET_KB, "KB");
+	bool withinTarget = perSession <= IDLE_SESSION_TARGET_KB;
+
+#ifdef RPCLIB_FROM_SOURCE
+	// the read buffers were written to by the call each session made, so they are resident
+	// and the measurement above sees them too
+	rpc::detail::buffer_pool::usage buffers = rpc::detail::buffer_pool::instance().get_usage();
+	if (buffers.sessions > 0)
+	{
+		double readKb = buffers.read_buffer_bytes / 1024.0 / buffers.sessions;
+		double responseKb = buffers.buffer_bytes / 1024.0 / buffers.sessions;
+		report("idle session read buffer", readKb, "KB");
+		report("idle session share of response buffers", responseKb, "KB");
+		report("pooled response buffers", (double)buffers.buffers_pooled, "");
+		report("idle session buffer target", IDLE_BUFFER_TARGET_KB, "KB");
+		withinTarget = withinTarget && readKb + responseKb <= IDLE_BUFFER_TARGET_KB;
+	}
+#endif
+	return withinTarget;
+}
+
+#ifndef _WIN32
+// the client ends of the idle sessions, in a child that opens them when told to go and
+// keeps them open until go is closed
+struct IdleClients
+{
+	pid_t pid;
+	int go;
+	int ready;
+};
+
+// forks the idle clients, before the server starts any threads so the child starts with
+// a clean copy of the process
+static bool startIdleClients(uint16_t port, int sessions, IdleClients & clients)
+{
+	// a descriptor per session on either side, more than the usual soft limit allows.
+	// raised before the fork so both processes get it
+	struct rlimit files;
+	if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+	{
+		files.rlim_cur = files.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &files);
+	}
+
+	int go[2], ready[2];
+	if (pipe(go) != 0 || pipe(ready) != 0)
+		return false;
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0)
+	{
+		close(go[1]);
+		close(ready[0]);
+		char byte;
+		if (read(go[0], &byte, 1) != 1)
+			_exit(0);
+		try
+		{
+			vector<unique_ptr<rpc::client>> open;
+			for (int i = 0; i < sessions; ++i)
+			{
+				open.push_back(unique_ptr<rpc::client>(new rpc::client("127.0.0.1", port)));
+				open.back()->call("checkConnection", DEFAULT_ROOM);
+			}
+			if (write(ready[1], &byte, 1) != 1)
+				_exit(1);
+			while (read(go[0], &byte, 1) > 0);
+		}
+		catch (exception & e)
+		{
+			cerr << "Idle client failed: " << e.what() << endl;
+			_exit(1);
+		}
+		_exit(0);
+	}
+	close(go[0]);
+	close(ready[1]);
+	clients.pid = pid;
+	clients.go = go[1];
+	clients.ready = ready[0];
+	return true;
+}
+
+// has the child open its sessions and measures what they added to this process
+static bool benchIdleSessions(const IdleClients & clients, int sessions)
+{
+	size_t before = residentMemoryBytes();
+	char byte = 1;
+	bool opened = write(clients.go, &byte, 1) == 1 && read(clients.ready, &byte, 1) == 1;
+	size_t after = residentMemoryBytes();
+	if (!opened)
+	{
+		cerr << "The idle clients could not open their sessions" << endl;
+		return false;
+	}
+	return reportIdleSessions(before, after, sessions);
+}
+
+static void stopIdleClients(const IdleClients & clients)
+{
+	close(clients.go);
+	close(clients.ready);
+	waitpid(clients.pid, NULL, 0);
+}
+#else
+// no fork here, both ends of every session live in this process, so this is an upper
+// bound on the server's share
+static bool benchIdleSessions(uint16_t port, int sessions)
+{
+	size_t before = residentMemoryBytes();
+	vector<unique_ptr<rpc::client>> clients;
+	for (int i = 0; i < sessions; ++i)
+	{
+		clients.push_back(unique_ptr<rpc::client>(new rpc::client("127.0.0.1", port)));
+		clients.back()->call(idOf("checkConnection"), DEFAULT_ROOM);
+	}
+	size_t after = residentMemoryBytes();
+	cout << "Both ends of the idle sessions are in this process" << endl;
+	return reportIdleSessions(before, after, sessions);
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+	uint16_t port = BENCH_PORT;
+	int sessions = DEFAULT_SESSIONS;
+	double lobbySeconds = DEFAULT_LOBBY_SECONDS;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--port" && i + 1 < argc)
+			port = (uint16_t)atoi(argv[++i]);
+		else if (arg == "--sessions" && i + 1 < argc)
+			sessions = max(1, atoi(argv[++i]));
+		else if (arg == "--lobby-seconds" && i + 1 < argc)
+			lobbySeconds = max(1.0, atof(argv[++i]));
+		else
+		{
+			cout << "Usage: " << argv[0] << " [--port PORT] [--sessions N] [--lobby-seconds S]" << endl;
+			return 1;
+		}
+	}
+
+#ifndef _WIN32
+	IdleClients idleClients;
+	if (!startIdleClients(port, sessions, idleClients))
+	{
+		cerr << "Unable to start the idle client process" << endl;
+		return 1;
+	}
+#endif
+
+	rpc::server srv("127.0.0.1", port);
+	ServerBinder binder(srv);
+	bindHandlers(binder);
+	methodNames = binder.names;
+	rooms.create();
+	srv.async_run(BENCH_WORKERS);
+
+	{
+		rpc::client client("127.0.0.1", port);
+		benchCalls(client, "getWorldSnapshot by name", "getWorldSnapshot");
+		benchCalls(client, "getWorldSnapshot by id", idOf("getWorldSnapshot"));
+		benchUploads(client);
+		benchLobby(client, lobbySeconds);
+	}
+	benchGetPoseThreads(port);
+#ifndef _WIN32
+	bool withinTarget = benchIdleSessions(idleClients, sessions);
+	stopIdleClients(idleClients);
+#else
+	bool withinTarget = benchIdleSessions(port, sessions);
+#endif
+
+	srv.close_sessions();
+	srv.stop();
+	return withinTarget ? 0 : 1;
+}
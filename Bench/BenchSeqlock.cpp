@@ -0,0 +1,189 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include "Bench.h"
+#include "PoseStore.h"
+#include "SpscRing.h"
+#include "Handlers.h"
+using namespace std;
+
+// the lock-free handoffs under contention: readers of a seqlock slot racing a writer,
+// the getPose handler against the mutex it replaced, and the rings between the client's
+// render and network threads. all of them also check that nothing torn or out of
+// order ever comes out.
+
+#define DEFAULT_SECONDS 1.0
+#define RING_ITEMS 2000000
+
+// a pose whose every field holds the same value, so a torn read shows up as a mismatch
+static s_Pose uniformPose(uint32_t value)
+{
+	float f = (float)value;
+	s_Pose pose = { f, f, f, f, f, f, f };
+	return pose;
+}
+
+static bool uniform(const s_Pose & pose)
+{
+	return pose.pos_x == pose.pos_y && pose.pos_y == pose.pos_z && pose.pos_z == pose.rot_x
+		&& pose.rot_x == pose.rot_y && pose.rot_y == pose.rot_z && pose.rot_z == pose.rot_w;
+}
+
+// returns how many reads came out torn
+static uint64_t benchSeqlock(int readers, double seconds)
+{
+	SeqlockSlot<s_Pose> slot;
+	atomic<bool> running(true);
+	atomic<uint64_t> reads(0), torn(0);
+	uint64_t writes = 0;
+
+	vector<thread> threads;
+	for (int r = 0; r < readers; ++r)
+	{
+		threads.push_back(thread([&]() {
+			uint64_t localReads = 0, localTorn = 0;
+			while (running.load(memory_order_relaxed))
+			{
+				if (!uniform(slot.load()))
+					++localTorn;
+				++localReads;
+			}
+			reads += localReads;
+			torn += localTorn;
+		}));
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	while (secondsSince(start) < seconds)
+	{
+		for (int i = 0; i < 1000; ++i)
+			slot.store(uniformPose((uint32_t)(++writes & 0xffffff)));
+	}
+	running = false;
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	double elapsed = secondsSince(start);
+
+	string name = "seqlock " + to_string(readers) + " readers";
+	report(name + " writes", writes / elapsed / 1e6, "M/s");
+	report(name + " reads", reads / elapsed / 1e6, "M/s");
+	report(name + " torn reads", (double)torn, "");
+	return torn;
+}
+
+// the server state before the seqlock: every pose behind one mutex
+static mutex stateMutex;
+static s_Pose mutexPoses[2][2];
+
+static void mutexSetPose(int, int player, int whichPose, s_Pose pose)
+{
+	lock_guard<mutex> lock(stateMutex);
+	mutexPoses[player == LEAP ? LEAP : OCULUS][whichPose == HEAD ? HEAD : HAND] = pose;
+}
+
+static s_Pose mutexGetPose(int, int player, int whichPose)
+{
+	lock_guard<mutex> lock(stateMutex);
+	return mutexPoses[player == LEAP ? LEAP : OCULUS][whichPose == HEAD ? HEAD : HAND];
+}
+
+// getPose the way the rpc workers call it, with one player's setPose racing the readers,
+// returns how many reads came out torn
+template <typename Get, typename Set>
+static uint64_t benchGetPose(const string & label, Get get, Set set, int readers, double seconds)
+{
+	atomic<bool> running(true);
+	atomic<uint64_t> reads(0), torn(0);
+
+	vector<thread> threads;
+	for (int r = 0; r < readers; ++r)
+	{
+		threads.push_back(thread([&]() {
+			uint64_t localReads = 0, localTorn = 0;
+			while (running.load(memory_order_relaxed))
+			{
+				if (!uniform(get(DEFAULT_ROOM, LEAP, HAND)))
+					++localTorn;
+				++localReads;
+			}
+			reads += localReads;
+			torn += localTorn;
+		}));
+	}
+
+	uint32_t writes = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	while (secondsSince(start) < seconds)
+	{
+		for (int i = 0; i < 1000; ++i)
+			set(DEFAULT_ROOM, LEAP, HAND, uniformPose(++writes & 0xffffff));
+	}
+	running = false;
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	double elapsed = secondsSince(start);
+
+	string name = label + " " + to_string(readers) + " threads";
+	report(name, reads / elapsed / 1e6, "M calls/s");
+	report(name + " torn reads", (double)torn, "");
+	return torn;
+}
+
+// returns how many items came out of order
+static uint64_t benchRing()
+{
+	SpscRing<uint64_t, 16> ring;
+	uint64_t outOfOrder = 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	thread consumer([&]() {
+		uint64_t expected = 0, value;
+		while (expected < RING_ITEMS)
+		{
+			if (!ring.pop(value))
+			{
+				this_thread::yield();
+				continue;
+			}
+			if (value != expected)
+				++outOfOrder;
+			expected = value + 1;
+		}
+	});
+	for (uint64_t i = 0; i < RING_ITEMS; ++i)
+	{
+		while (!ring.push(i))
+			this_thread::yield();
+	}
+	consumer.join();
+	double elapsed = secondsSince(start);
+
+	report("spsc ring transfers", RING_ITEMS / elapsed / 1e6, "M/s");
+	report("spsc ring out of order", (double)outOfOrder, "");
+	return outOfOrder;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : DEFAULT_SECONDS;
+
+	// up to the number of rpc workers the server would run on this machine
+	int cores = max(1u, thread::hardware_concurrency());
+	uint64_t errors = 0;
+	for (int readers = 1; readers <= cores; readers *= 2)
+		errors += benchSeqlock(readers, seconds);
+
+	// the thread counts the server is usually run with
+	rooms.create();
+	for (int threads = 1; threads <= 8; threads *= 2)
+	{
+		errors += benchGetPose("getPose seqlock", &getPose, &setPose, threads, seconds);
+		errors += benchGetPose("getPose mutex", &mutexGetPose, &mutexSetPose, threads, seconds);
+	}
+
+	errors += benchRing();
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Bench.h"
+#include "Rooms.h"
+#include "Simulation.h"
+#include "SnapshotBuffer.h"
+using namespace std;
+
+// cpu cost of the game itself: a ball step, a server tick across every room and
+// the client's jitter buffer, all without a network or any devices. also checks the
+// fixed step gives the same ball however the frames were sliced, that a long frame
+// drops the steps past the cap, and that a fast ball can't slip past a paddle.
+
+#define STEPS 2000000
+#define SIMULATED_SECONDS 5
+#define SAMPLES 1000000
+#define RALLY_SECONDS 60
+#define FAST_BALL_SPEED 60.0f
+
+// hand swinging across the table so the ball keeps getting hit
+static s_Pose swingingHand(int player, int tick)
+{
+	float t = tick * TICK_SECONDS * 2.0f + player;
+	s_Pose pose = { 0.4f * sinf(t), 1.2f, player == OCULUS ? -1.0f : 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	return pose;
+}
+
+static void benchStepBall()
+{
+	BallState ball;
+	resetBall(ball);
+	s_Pose hands[2] = { swingingHand(OCULUS, 0), swingingHand(LEAP, 0) };
+	int hits = 0;
+	report("stepBall", nsPerIteration(STEPS, [&](uint64_t i) {
+		hands[i & 1] = swingingHand((int)(i & 1), (int)i);
+		if (stepBall(ball, hands, TICK_SECONDS))
+			++hits;
+	}), "ns");
+	keep(hits);
+}
+
+// plays the same rally once in exact ticks in a plain loop, then again through a
+// FixedStep fed uneven frame times. the sliced ball must match the exact one bit for bit
+// at every tick, and the clock must run every tick the frames added up to
+static bool benchFixedStep()
+{
+	const int ticks = TICK_RATE * RALLY_SECONDS;
+	vector<BallState> exact(ticks);
+	BallState ball;
+	resetBall(ball);
+	for (int tick = 0; tick < ticks; ++tick)
+	{
+		s_Pose hands[2] = { swingingHand(OCULUS, tick), swingingHand(LEAP, tick) };
+		stepBall(ball, hands, TICK_SECONDS);
+		exact[tick] = ball;
+	}
+
+	BallState sliced;
+	resetBall(sliced);
+	FixedStep clock;
+	int mismatches = 0;
+	int tick = 0;
+	double elapsed = 0.0;
+	for (uint64_t frame = 0; tick < ticks; ++frame)
+	{
+		// frame times between 2 and 30 ms, the same sequence every run, never enough to hit the cap
+		double frameTime = 0.002 + (double)((frame * 2654435761u) % 28) / 1000.0;
+		elapsed += frameTime;
+		int steps = clock.advance(frameTime);
+		for (int i = 0; i < steps && tick < ticks; ++i, ++tick)
+		{
+			s_Pose hands[2] = { swingingHand(OCULUS, tick), swingingHand(LEAP, tick) };
+			stepBall(sliced, hands, TICK_SECONDS);
+			if (memcmp(&exact[tick].position, &sliced.position, sizeof(sliced.position)) != 0 ||
+				memcmp(&exact[tick].velocity, &sliced.velocity, sizeof(sliced.velocity)) != 0)
+				++mismatches;
+		}
+	}
+	// the last frame may have been due more steps than the rally had left
+	int lost = (int)(elapsed / TICK_SECONDS) - tick;
+	report("fixed step mismatches", mismatches, "");
+	report("fixed step ticks lost", lost, "");
+	return mismatches == 0 && lost >= 0 && lost < MAX_STEPS_PER_UPDATE;
+}
+
+// one frame long enough to owe more than MAX_STEPS_PER_UPDATE steps, the clock runs the
+// cap, drops the rest of the whole steps and keeps only the fraction of a step
+static bool benchLongFrame()
+{
+	const double frameTime = (MAX_STEPS_PER_UPDATE * 4 + 0.25) * TICK_SECONDS;
+	FixedStep clock;
+	int steps = clock.advance(frameTime);
+	int dropped = (int)(frameTime / TICK_SECONDS) - steps;
+	double banked = TICK_SECONDS - clock.untilNextStep();
+	int after = clock.advance(0.0);
+
+	report("long frame steps", steps, "");
+	report("long frame steps dropped", dropped, "");
+	return steps == MAX_STEPS_PER_UPDATE && dropped == MAX_STEPS_PER_UPDATE * 3 &&
+		fabs(banked - 0.25 * TICK_SECONDS) < 1e-9 && after == 0;
+}
+
+// fires a ball far faster than a serve at a paddle standing still, it must be returned
+static void benchFastBall()
+{
+	s_Pose hands[2] = { swingingHand(OCULUS, 0), swingingHand(LEAP, 0) };
+	hands[LEAP].pos_x = 0.0f;
+	int misses = 0;
+	for (int offset = 0; offset < TICK_RATE; ++offset)
+	{
+		// start each shot a different fraction of a tick away from the paddle
+		BallState ball;
+		resetBall(ball);
+		ball.position = glm::vec3(0.0f, hands[LEAP].pos_y, hands[LEAP].pos_z + 1.0f + offset / (float)TICK_RATE);
+		ball.velocity = glm::vec3(0.0f, 0.0f, -FAST_BALL_SPEED);
+		bool hit = false;
+		for (int tick = 0; tick < TICK_RATE && !hit; ++tick)
+			hit = stepBall(ball, hands, TICK_SECONDS);
+		if (!hit)
+			++misses;
+	}
+	report("fast ball misses", misses, "");
+}
+
+// a server tick with every room in play, players moving between ticks like the rpc workers would
+static void benchTick(int roomCount)
+{
+	unique_ptr<RoomRegistry> registry(new RoomRegistry());
+	vector<Room *> rooms;
+	for (int i = 0; i < roomCount; ++i)
+	{
+		int roomId = registry->create();
+		registry->join(roomId, OCULUS);
+		registry->join(roomId, LEAP);
+		Room * room = registry->find(roomId);
+		room->markReady(OCULUS);
+		room->markReady(LEAP);
+		rooms.push_back(room);
+	}
+
+	const int ticks = TICK_RATE * SIMULATED_SECONDS;
+	chrono::steady_clock::duration busy(0);
+	for (int tick = 0; tick < ticks; ++tick)
+	{
+		for (size_t r = 0; r < rooms.size(); ++r)
+		{
+			rooms[r]->poses.set(OCULUS, HAND, swingingHand(OCULUS, tick + (int)r));
+			rooms[r]->poses.set(LEAP, HAND, swingingHand(LEAP, tick + (int)r));
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		registry->tick(TICK_SECONDS);
+		busy += chrono::steady_clock::now() - start;
+	}
+
+	double tickUs = chrono::duration<double, micro>(busy).count() / ticks;
+	string name = "tick " + to_string(roomCount) + " rooms";
+	report(name, tickUs, "us");
+	report(name + " per room", tickUs / roomCount, "us");
+	report(name + " share of a core", 100.0 * tickUs * TICK_RATE / 1e6, "%");
+}
+
+// render loop sampling a remote player at 90 Hz while snapshots arrive at the tick rate,
+// timed per frame including the pushes that came in since the last one
+static void benchSnapshotBuffer()
+{
+	SnapshotBuffer buffer;
+	ovrPosef head = ovrPosef(), hand = ovrPosef();
+	head.Orientation.w = hand.Orientation.w = 1.0f;
+
+	BallState ball;
+	resetBall(ball);
+
+	double localTime = 0.0;
+	int nextSnapshot = 0;
+	report("SnapshotBuffer frame", nsPerIteration(SAMPLES, [&](uint64_t i) {
+		localTime = i / 90.0;
+		while (nextSnapshot * TICK_SECONDS <= localTime)
+		{
+			head.Position.x = sinf((float)nextSnapshot * TICK_SECONDS);
+			moveBall(ball, TICK_SECONDS);
+			buffer.push(nextSnapshot * TICK_SECONDS, head, hand, ball, localTime);
+			++nextSnapshot;
+		}
+		ovrPosef sampledHead, sampledHand;
+		buffer.sample(localTime, sampledHead, sampledHand);
+		keep(sampledHead);
+		BallState sampledBall;
+		buffer.sampleBall(localTime, sampledBall);
+		keep(sampledBall.position);
+	}), "ns");
+}
+
+int main()
+{
+	benchStepBall();
+	bool sliced = benchFixedStep();
+	bool capped = benchLongFrame();
+	benchFastBall();
+	for (int rooms = 1; rooms <= MAX_ROOMS; rooms *= 4)
+		benchTick(rooms);
+	benchSnapshotBuffer();
+	return (sliced && capped) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include <rpc/server.h>
+#include <rpc/client.h>
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#ifdef __linux__
+#include <dlfcn.h>
+#include <sys/socket.h>
+#endif
+
+#include "Bench.h"
+#include "SerializablePose.h"
+#include "Handlers.h"
+using namespace std;
+
+// how rpc writes coalesce: socket sends per frame and frames per second for each way a
+// client has sent one frame of input. client and server share the process, so the sends
+// of both ends are counted. the server only gathers queued answers into one write when
+// rpclib is built from RPCLIB_SOURCE_DIR against the async_writer in Include, a prebuilt
+// rpclib gives the baseline. the client's own write queue is inside rpclib and never
+// gathers, so fewer sends there only come from fewer messages.
+
+#define BENCH_PORT 8094
+#define BENCH_WORKERS 2
+#define FRAMES 20000
+
+static atomic<uint64_t> socketSends(0);
+
+#ifdef __linux__
+// asio sends on sockets through these, defining them here puts the counter in front of libc
+extern "C" ssize_t sendmsg(int fd, const struct msghdr * msg, int flags)
+{
+	typedef ssize_t (*SendMsg)(int, const struct msghdr *, int);
+	static SendMsg real = (SendMsg)dlsym(RTLD_NEXT, "sendmsg");
+	++socketSends;
+	return real(fd, msg, flags);
+}
+
+extern "C" ssize_t send(int fd, const void * data, size_t size, int flags)
+{
+	typedef ssize_t (*Send)(int, const void *, size_t, int);
+	static Send real = (Send)dlsym(RTLD_NEXT, "send");
+	++socketSends;
+	return real(fd, data, size, flags);
+}
+#define COUNTING_SENDS true
+#else
+#define COUNTING_SENDS false
+#endif
+
+// runs frames and reports how many sends and how much time each took, flush makes sure
+// the server got through everything before the clock stops
+template <typename F>
+void benchFrames(rpc::client & client, const string & name, F frame)
+{
+	uint64_t sendsBefore = socketSends;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < FRAMES; ++i)
+		frame(i);
+	client.call("checkConnection", DEFAULT_ROOM);
+	double seconds = secondsSince(start);
+
+	report(name, FRAMES / seconds, "frames/s");
+	if (COUNTING_SENDS)
+		report(name + " sends", (double)(socketSends - sendsBefore) / FRAMES, "per frame");
+}
+
+int main(int argc, char* argv[])
+{
+	uint16_t port = BENCH_PORT;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--port" && i + 1 < argc)
+			port = (uint16_t)atoi(argv[++i]);
+		else
+		{
+			cout << "Usage: " << argv[0] << " [--port PORT]" << endl;
+			return 1;
+		}
+	}
+	if (!COUNTING_SENDS)
+		cout << "Socket sends are only counted on Linux" << endl;
+
+	rpc::server srv("127.0.0.1", port);
+	bindHandlers(srv);
+	rooms.create();
+	srv.async_run(BENCH_WORKERS);
+
+	s_Pose pose = { 0.1f, 1.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f };
+	s_PlayerState state;
+	state.head = packPose(pose);
+	state.hand = packPose(pose);
+
+	{
+		rpc::client client("127.0.0.1", port);
+
+		// the original client: both poses set and both remote poses read, four calls
+		// in flight at once, each with its promise
+		benchFrames(client, "4 async_call", [&](int) {
+			future<RPCLIB_MSGPACK::object_handle> calls[4] = {
+				client.async_call("setPose", DEFAULT_ROOM, OCULUS, HEAD, pose),
+				client.async_call("setPose", DEFAULT_ROOM, OCULUS, HAND, pose),
+				client.async_call("getPose", DEFAULT_ROOM, LEAP, HEAD),
+				client.async_call("getPose", DEFAULT_ROOM, LEAP, HAND)
+			};
+			for (int i = 0; i < 4; ++i)
+				calls[i].get();
+		});
+
+		// the poses as notifications, no promise and no answer, the reads still calls
+		benchFrames(client, "2 send + 2 async_call", [&](int) {
+			client.send("setPose", DEFAULT_ROOM, OCULUS, HEAD, pose);
+			client.send("setPose", DEFAULT_ROOM, OCULUS, HAND, pose);
+			future<RPCLIB_MSGPACK::object_handle> head = client.async_call("getPose", DEFAULT_ROOM, LEAP, HEAD);
+			future<RPCLIB_MSGPACK::object_handle> hand = client.async_call("getPose", DEFAULT_ROOM, LEAP, HAND);
+			head.get();
+			hand.get();
+		});
+
+		// the current client: one notification per frame, the world comes back on a
+		// subscription that only answers when it changed
+		unsigned int sequence = 0;
+		benchFrames(client, "1 send", [&](int) {
+			client.send("pushPlayerState", DEFAULT_ROOM, OCULUS, ++sequence, state);
+		});
+	}
+
+	srv.close_sessions();
+	srv.stop();
+	return 0;
+}
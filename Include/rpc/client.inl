@@ -50,6 +50,7 @@ client::async_call(std::string const &func_name, Args... args) {
 template <typename... Args>
 void client::send(std::string const &func_name, Args... args) {
     RPCLIB_CREATE_LOG_CHANNEL(client)
+    wait_conn();
     LOG_DEBUG("Sending notification {}", func_name);
 
     auto args_obj = std::make_tuple(args...);
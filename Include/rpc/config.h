@@ -12,8 +12,22 @@ namespace rpc
 {
 
 //! \brief
+//! DEFAULT_BUFFER_SIZE is what a client, or a server session built without the
+//! local sources, reserves in its unpacker. Game messages are a few hundred
+//! bytes at most and the unpacker grows on demand, so it is kept small to let
+//! idle sessions stay cheap.
+//! Server sessions built from source start their read buffer at
+//! MIN_SESSION_BUFFER_SIZE, double it while messages or bursts don't fit, up
+//! to DEFAULT_BUFFER_SIZE for bursts, and halve it again once reads are small.
+//! Responses are packed into buffers of RESPONSE_BUFFER_SIZE shared by every
+//! session, at most MAX_POOLED_BUFFERS of them no bigger than
+//! MAX_POOLED_BUFFER_SIZE are kept between responses.
 struct constants RPCLIB_FINAL {
-    static RPCLIB_CONSTEXPR std::size_t DEFAULT_BUFFER_SIZE = 1024 << 10;
+    static RPCLIB_CONSTEXPR std::size_t DEFAULT_BUFFER_SIZE = 64 << 10;
+    static RPCLIB_CONSTEXPR std::size_t MIN_SESSION_BUFFER_SIZE = 2 << 10;
+    static RPCLIB_CONSTEXPR std::size_t RESPONSE_BUFFER_SIZE = 1 << 10;
+    static RPCLIB_CONSTEXPR std::size_t MAX_POOLED_BUFFER_SIZE = 16 << 10;
+    static RPCLIB_CONSTEXPR std::size_t MAX_POOLED_BUFFERS = 256;
     static RPCLIB_CONSTEXPR std::uint16_t DEFAULT_PORT = 8080;
 };
 
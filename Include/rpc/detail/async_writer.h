@@ -5,10 +5,14 @@
 
 #include "asio.hpp"
 #include "rpc/msgpack.hpp"
+#ifdef RPCLIB_FROM_SOURCE
+#include "rpc/detail/buffer_pool.h"
+#endif
 #include <condition_variable>
 #include <deque>
 #include <memory>
 #include <thread>
+#include <vector>
 
 namespace rpc {
 
@@ -23,21 +27,47 @@ public:
                  RPCLIB_ASIO::ip::tcp::socket socket)
         : socket_(std::move(socket)), write_strand_(*io), exit_(false) {}
 
+#ifdef RPCLIB_FROM_SOURCE
+    ~async_writer() {
+        for (auto buf : write_queue_) {
+            buffer_pool::instance().give_back(buf);
+        }
+    }
+#endif
+
     void do_write() {
         if (exit_) {
             return;
         }
         auto self(shared_from_this());
-        auto &item = write_queue_.front();
-        // the data in item remains valid until the handler is called
-        // since it will still be in the queue physically until then.
+        // everything queued so far goes out in a single gathered write.
+        // the data in the items remains valid until the handler is called
+        // since they will still be in the queue physically until then, and
+        // pushing more to the back of a deque doesn't move them.
+        std::vector<RPCLIB_ASIO::const_buffer> buffers;
+        buffers.reserve(write_queue_.size());
+        for (auto &item : write_queue_) {
+#ifdef RPCLIB_FROM_SOURCE
+            buffers.push_back(
+                RPCLIB_ASIO::buffer(item->data.data(), item->data.size()));
+#else
+            buffers.push_back(RPCLIB_ASIO::buffer(item.data(), item.size()));
+#endif
+        }
+        std::size_t count = buffers.size();
         RPCLIB_ASIO::async_write(
-            socket_, RPCLIB_ASIO::buffer(item.data(), item.size()),
+            socket_, buffers,
             write_strand_.wrap(
-                [this, self](std::error_code ec, std::size_t transferred) {
+                [this, self, count](std::error_code ec, std::size_t transferred) {
                     (void)transferred;
                     if (!ec) {
-                        write_queue_.pop_front();
+#ifdef RPCLIB_FROM_SOURCE
+                        for (std::size_t i = 0; i < count; ++i) {
+                            buffer_pool::instance().give_back(write_queue_[i]);
+                        }
+#endif
+                        write_queue_.erase(write_queue_.begin(),
+                                           write_queue_.begin() + count);
                         if (write_queue_.size() > 0) {
                             if (!exit_) {
                                 do_write();
@@ -56,6 +86,25 @@ public:
                 }));
     }
 
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief Queues a buffer from the pool, it goes back to the pool once
+    //! it was written.
+    void write(pooled_buffer *buf) {
+        write_queue_.push_back(buf);
+        if (write_queue_.size() > 1) {
+            return; // there is an ongoing write chain so don't start another
+        }
+
+        do_write();
+    }
+
+    void write(RPCLIB_MSGPACK::sbuffer &&data) {
+        // copied into a pooled buffer, so every queued buffer is the pool's
+        auto buf = buffer_pool::instance().take();
+        buf->data.write(data.data(), data.size());
+        write(buf);
+    }
+#else
     void write(RPCLIB_MSGPACK::sbuffer &&data) {
         write_queue_.push_back(std::move(data));
         if (write_queue_.size() > 1) {
@@ -64,6 +113,7 @@ public:
 
         do_write();
     }
+#endif
 
     friend class rpc::client;
 
@@ -76,7 +126,11 @@ protected:
     std::condition_variable cv_exit_;
 
 private:
+#ifdef RPCLIB_FROM_SOURCE
+    std::deque<pooled_buffer *> write_queue_;
+#else
     std::deque<RPCLIB_MSGPACK::sbuffer> write_queue_;
+#endif
     RPCLIB_CREATE_LOG_CHANNEL(async_writer)
 };
 
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifndef BUFFER_POOL_H_R4Q8WZ3N
+#define BUFFER_POOL_H_R4Q8WZ3N
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "rpc/msgpack.hpp"
+
+namespace rpc {
+namespace detail {
+
+//! \brief A response buffer that goes back to the pool once it was written.
+struct pooled_buffer {
+    RPCLIB_MSGPACK::sbuffer data;
+    //! \brief How far the buffer has grown, sbuffer doesn't tell.
+    std::size_t capacity;
+};
+
+//! \brief Response buffers shared by every session of the process, and
+//! the count of what the sessions hold in read buffers.
+class buffer_pool {
+public:
+    //! \brief What the sessions and the pool hold at one point in time.
+    struct usage {
+        std::size_t sessions;
+        std::size_t read_buffer_bytes;
+        std::size_t buffers_in_use;
+        std::size_t buffers_pooled;
+        //! \brief All response buffers, in use and pooled.
+        std::size_t buffer_bytes;
+    };
+
+    static buffer_pool &instance();
+
+    //! \brief An empty buffer, reused if one is pooled.
+    pooled_buffer *take();
+
+    //! \brief Clears a written buffer and pools it, unless it grew past
+    //! MAX_POOLED_BUFFER_SIZE or the pool is full.
+    void give_back(pooled_buffer *buf);
+
+    //! \brief Sessions add how much their read buffers grew or shrank.
+    void track_read_buffer(std::ptrdiff_t bytes);
+    void track_session(int count);
+
+    usage get_usage();
+
+private:
+    buffer_pool() = default;
+
+    std::mutex mut_;
+    std::vector<pooled_buffer *> free_;
+    std::size_t in_use_ = 0;
+    std::size_t buffer_bytes_ = 0;
+    std::atomic<std::ptrdiff_t> read_buffer_bytes_{0};
+    std::atomic<int> sessions_{0};
+};
+
+} /* detail */
+} /* rpc */
+
+#endif /* end of include guard: BUFFER_POOL_H_R4Q8WZ3N */
@@ -5,6 +5,7 @@
 
 #include "asio.hpp"
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "rpc/config.h"
@@ -25,6 +26,9 @@ public:
     server_session(server *srv, RPCLIB_ASIO::io_service *io,
                    RPCLIB_ASIO::ip::tcp::socket socket,
                    std::shared_ptr<dispatcher> disp, bool suppress_exceptions);
+#ifdef RPCLIB_FROM_SOURCE
+    ~server_session();
+#endif
     void start();
 
     void close();
@@ -32,13 +36,55 @@ public:
 private:
     void do_read();
 
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief Parses every whole message in the read buffer and hands each
+    //! to a worker, keeping the start of an unfinished one for the next read.
+    bool dispatch_buffered();
+
+    //! \brief Grows the read buffer after a read that filled it, shrinks
+    //! it after a run of small ones.
+    void adapt_read_buffer(std::size_t length, bool filled);
+
+    //! \brief Moves the unparsed bytes into a buffer of the given size.
+    void resize_read_buffer(std::size_t capacity);
+
+    //! \brief Runs one call or notification on a worker and queues its
+    //! response.
+    void dispatch_one(RPCLIB_MSGPACK::object const &msg);
+
+    //! \brief A zone for the next message, reused from earlier ones.
+    std::unique_ptr<RPCLIB_MSGPACK::zone> take_zone();
+
+    //! \brief Clears a zone once its message was dispatched and keeps it
+    //! for the next one.
+    void give_back_zone(RPCLIB_MSGPACK::zone *z);
+#endif
+
 private:
     server* parent_;
     RPCLIB_ASIO::io_service *io_;
     RPCLIB_ASIO::strand read_strand_;
     std::shared_ptr<dispatcher> disp_;
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief Bytes read from the socket, the ones before read_end_ are not
+    //! parsed yet.
+    std::unique_ptr<char[]> read_buf_;
+    std::size_t read_capacity_ = 0;
+    std::size_t read_end_ = 0;
+    //! \brief Reads in a row that used little of the buffer.
+    unsigned quiet_reads_ = 0;
+    //! \brief Parse state of the message being read, it carries over
+    //! between reads when a message arrives in pieces.
+    RPCLIB_MSGPACK::detail::context ctx_;
+    std::unique_ptr<RPCLIB_MSGPACK::zone> zone_;
+    //! \brief Zones of dispatched messages, a session needs as many as it
+    //! has calls in flight.
+    std::mutex zones_mutex_;
+    std::vector<std::unique_ptr<RPCLIB_MSGPACK::zone>> free_zones_;
+#else
     RPCLIB_MSGPACK::unpacker pac_;
     RPCLIB_MSGPACK::sbuffer output_buf_;
+#endif
     const bool suppress_exceptions_;
     RPCLIB_CREATE_LOG_CHANNEL(session)
 };
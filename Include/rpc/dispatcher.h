@@ -7,6 +7,7 @@
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "rpc/config.h"
 #include "rpc/msgpack.hpp"
@@ -70,6 +71,31 @@ public:
     //! functions' parameters.
     void dispatch(RPCLIB_MSGPACK::sbuffer const &msg);
 
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief Processes a message that contains a call or a notification
+    //! according to the Msgpack-RPC spec, packing the response to a call
+    //! straight into out.
+    //! \param msg The messagepack object that contains the call.
+    //! \param out The buffer the response is packed into, cleared first.
+    //! \param suppress_exceptions If true, exceptions will be caught and
+    //! written as response for the client.
+    //! \returns False if there is nothing to send back: the message was a
+    //! notification or the handler disabled its response.
+    //! \throws std::runtime_error If the types of the parameters are not
+    //! convertible to the called functions' parameters.
+    bool dispatch(RPCLIB_MSGPACK::object const &msg,
+                  RPCLIB_MSGPACK::sbuffer &out,
+                  bool suppress_exceptions = false);
+
+    //! \brief Packs the result of a call straight into a buffer, nothing is
+    //! packed for notifications.
+    using result_packer = RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer>;
+
+    //! \brief This functor type unifies the interfaces of functions that are
+    //!        called remotely. result is null for notifications.
+    using adaptor_type = std::function<void(RPCLIB_MSGPACK::object const &args,
+                                            result_packer *result)>;
+#else
     //! \brief Processes a message that contains a call according to
     //! the Msgpack-RPC spec.
     //! \param msg The messagepack object that contains the call.
@@ -85,6 +111,7 @@ public:
     //!        called remotely
     using adaptor_type = std::function<std::unique_ptr<RPCLIB_MSGPACK::object_handle>(
         RPCLIB_MSGPACK::object const &)>;
+#endif
 
     //! \brief This is the type of messages as per the msgpack-rpc spec.
     using call_t = std::tuple<int8_t, uint32_t, std::string, RPCLIB_MSGPACK::object>;
@@ -98,6 +125,29 @@ private:
     static void enforce_arg_count(std::string const &func, std::size_t found,
                                   std::size_t expected);
 
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief Dispatches a call, packing its response into out.
+    bool dispatch_call(RPCLIB_MSGPACK::object const &msg,
+                       RPCLIB_MSGPACK::sbuffer &out, bool suppress_exceptions);
+
+    //! \brief Dispatches a notification (which will not have a response)
+    void dispatch_notification(RPCLIB_MSGPACK::object const &msg,
+                               bool suppress_exceptions);
+
+    //! \brief Interns a bound functor under the next id, the first functor
+    //! bound to a name wins.
+    void add(std::string const &name, adaptor_type func);
+
+    //! \brief Finds the functor bound to name, null if there is none. Reads
+    //! the name in place, it is never copied.
+    adaptor_type const *find(RPCLIB_MSGPACK::object const &name) const;
+
+    //! \brief Picks a seed and a table size that put every bound name in a
+    //! slot of its own.
+    void rebuild_table();
+
+    static uint32_t hash(uint32_t seed, char const *data, std::size_t size);
+#else
     //! \brief Dispatches a call (which will have a response).
     detail::response dispatch_call(RPCLIB_MSGPACK::object const &msg,
                                    bool suppress_exceptions = false);
@@ -105,13 +155,28 @@ private:
     //! \brief Dispatches a notification (which will not have a response)
     detail::response dispatch_notification(RPCLIB_MSGPACK::object const &msg,
                                            bool suppress_exceptions = false);
+#endif
 
     template <typename T> RPCLIB_MSGPACK::object pack(T &&arg);
 
     enum class request_type { call = 0, notification = 2 };
 
 private:
+#ifdef RPCLIB_FROM_SOURCE
+    //! \brief A bound functor, its index in funcs_ is its interned id.
+    struct entry {
+        std::string name;
+        adaptor_type func;
+    };
+
+    std::vector<entry> funcs_;
+    //! \brief Perfect hash of the names, each slot holds an index into
+    //! funcs_ plus one or zero when it is empty.
+    std::vector<uint16_t> slots_;
+    uint32_t seed_ = 0;
+#else
     std::unordered_map<std::string, adaptor_type> funcs_;
+#endif
     RPCLIB_CREATE_LOG_CHANNEL(dispatcher)
 };
 }
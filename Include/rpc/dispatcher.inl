@@ -7,6 +7,78 @@ template <typename F> void dispatcher::bind(std::string const &name, F func) {
          typename detail::func_kind_info<F>::args_kind());
 }
 
+#ifdef RPCLIB_FROM_SOURCE
+// the adaptors convert the arguments and pack the result straight into the
+// response buffer, nothing goes through a zone or an object_handle
+
+template <typename F>
+void dispatcher::bind(std::string const &name, F func,
+                      detail::tags::void_result const &,
+                      detail::tags::zero_arg const &) {
+    add(name, [func, name](RPCLIB_MSGPACK::object const &args,
+                           result_packer *result) {
+        enforce_arg_count(name, 0, args.via.array.size);
+        func();
+        if (result) {
+            result->pack_nil();
+        }
+    });
+}
+
+template <typename F>
+void dispatcher::bind(std::string const &name, F func,
+                      detail::tags::void_result const &,
+                      detail::tags::nonzero_arg const &) {
+    using detail::func_traits;
+    using args_type = typename func_traits<F>::args_type;
+
+    add(name, [func, name](RPCLIB_MSGPACK::object const &args,
+                           result_packer *result) {
+        constexpr int args_count = std::tuple_size<args_type>::value;
+        enforce_arg_count(name, args_count, args.via.array.size);
+        args_type args_real;
+        args.convert(&args_real);
+        detail::call(func, args_real);
+        if (result) {
+            result->pack_nil();
+        }
+    });
+}
+
+template <typename F>
+void dispatcher::bind(std::string const &name, F func,
+                      detail::tags::nonvoid_result const &,
+                      detail::tags::zero_arg const &) {
+    add(name, [func, name](RPCLIB_MSGPACK::object const &args,
+                           result_packer *result) {
+        enforce_arg_count(name, 0, args.via.array.size);
+        auto &&value = func();
+        if (result) {
+            result->pack(value);
+        }
+    });
+}
+
+template <typename F>
+void dispatcher::bind(std::string const &name, F func,
+                      detail::tags::nonvoid_result const &,
+                      detail::tags::nonzero_arg const &) {
+    using detail::func_traits;
+    using args_type = typename func_traits<F>::args_type;
+
+    add(name, [func, name](RPCLIB_MSGPACK::object const &args,
+                           result_packer *result) {
+        constexpr int args_count = std::tuple_size<args_type>::value;
+        enforce_arg_count(name, args_count, args.via.array.size);
+        args_type args_real;
+        args.convert(&args_real);
+        auto &&value = detail::call(func, args_real);
+        if (result) {
+            result->pack(value);
+        }
+    });
+}
+#else
 template <typename F>
 void dispatcher::bind(std::string const &name, F func,
                       detail::tags::void_result const &,
@@ -70,5 +142,6 @@ void dispatcher::bind(std::string const &name, F func,
         return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>(result, std::move(z));
     }));
 }
+#endif
 }
 }
@@ -2,41 +2,23 @@
 
 Ball::Ball() : Model(BALL_PATH)
 {
-	for (GLuint i = 0; i < this->meshes.size(); i++) {
-		meshes[i].toWorld = glm::scale(meshes[i].toWorld, glm::vec3(0.2f, 0.2f, 0.2f));
-	}
-	velocity = glm::vec3(0.0f, 0.0f, 0.3f);
-	released = true;
-	lastPlayer = 0;
-	outOfBounds = false;
+	resetBall(state);
+	updateMeshes();
 	cerr << "Ball mesh size: " << meshes.size() << endl;
 }
 
-void Ball::update(float deltaTime) 
+// takes the state to draw, as the server simulated it
+void Ball::setState(const BallState & newState)
 {
-	deltaTime *= 100.0f;
-	glm::vec3 cent = calcCenterPoint();
-	if (cent.z > 3.0f || cent.z < -3.0f)
-	{
-		velocity = glm::vec3(0.0f, 0.0f, 0.3f);
-		for (GLuint i = 0; i < this->meshes.size(); i++) {
-			meshes[i].toWorld = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f)), velocity * deltaTime);
-		}
-		lastPlayer = 0;
-		outOfBounds = true;
-	}
-	if (cent.x > 1.0f || cent.x < -1.0f)
-	{
-		velocity = glm::reflect(velocity, glm::vec3(1.0f, 0.0f, 0.0f));
-	}
-	if (cent.y > 0.7f || cent.y < -1.0f)
-	{
-		velocity = glm::reflect(velocity, glm::vec3(0.0f, 1.0f, 0.0f));
-	}
-	if (released) {
-		for (GLuint i = 0; i < this->meshes.size(); i++) {
-			meshes[i].toWorld = glm::translate(meshes[i].toWorld, velocity * deltaTime);
-		}
+	state = newState;
+	updateMeshes();
+}
+
+// rebuilds the per-mesh transforms from the ball's center
+void Ball::updateMeshes()
+{
+	for (GLuint i = 0; i < this->meshes.size(); i++) {
+		meshes[i].toWorld = ballMatrix(state);
 	}
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "Model.h"
 #include "Shader.h"
+#include "Simulation.h"
 #define BALL_PATH "Assets/dekunut/Deku_Nut.obj"
 
 class Ball : public Model
@@ -8,13 +9,10 @@ class Ball : public Model
 public:
 	Ball();
 	void Draw(Shader shader);
-	void update(float deltaTime);
+	void setState(const BallState & newState);
 	glm::vec3 calcCenterPoint();
 	~Ball();
-	glm::vec3 velocity;
-	glm::mat4 toWorld;
-	int lastPlayer;
-	bool released;
-	bool outOfBounds;
+	BallState state;
+private:
+	void updateMeshes();
 };
-
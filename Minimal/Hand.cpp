@@ -1,16 +1,7 @@
 #include "Hand.h"
-Hand::Hand(ovrSession _session, long long frame, bool isleft) : Model(HAND_PATH)
+Hand::Hand(const ovrPosef & pose) : Model(HAND_PATH)
 {
-	if (isleft) {
-		handiness = 0;
-	}
-	else {
-		handiness = 1;
-	}
-
-	displayMidpointSeconds = ovr_GetPredictedDisplayTime(_session, frame);
-	trackState = ovr_GetTrackingState(_session, displayMidpointSeconds, ovrTrue);
-	HandPose = trackState.HandPoses[handiness].ThePose;
+	HandPose = pose;
 
 	bool HandHigh = false;
 	if (HandPose.Position.y > 1.0f) {
@@ -45,34 +36,6 @@ void Hand::calcAABB() {
 	//cout << "min: " << min.x << min.y << min.z << endl;
 	//cout << "max: " << max.x << max.y << max.z << endl;
 }
-void Hand::pollOculusInput(ovrSession _session, long long frame) {
-	displayMidpointSeconds = ovr_GetPredictedDisplayTime(_session, frame);
-	trackState = ovr_GetTrackingState(_session, displayMidpointSeconds, ovrTrue);
-	HandPose = trackState.HandPoses[handiness].ThePose;
-}
-
-void Hand::pollLeapInput(Leap::Controller & controller, Player & player) {
-	if (controller.frame(0).hands().count() > 0) {
-		if (controller.frame(0).isValid()) {
-			Leap::HandList hands = controller.frame(0).hands();
-			int i = 0;
-			auto hl = hands.begin();
-			if ((*hl).isValid()) {
-				//cout << (*hl).palmPosition().toString() << endl;
-				//cout << i << endl;
-				Leap::Vector pos = (*hl).palmPosition();
-				player.hand->HandPose.Position.x = -pos.x / 100.0f;
-				player.hand->HandPose.Position.y = pos.y / 100.0f - 1.0f;
-				player.hand->HandPose.Position.z = -pos.z / 100.0f - 2.3f;
-
-				player.hand->HandPose.Orientation.x = (*hl).palmNormal().x;
-				player.hand->HandPose.Orientation.y = -(*hl).palmNormal().y;
-				player.hand->HandPose.Orientation.z = (*hl).palmNormal().z;
-				player.hand->HandPose.Orientation.w = 0;
-			}
-		}
-	}
-}
 bool Hand::update() {
 	//cout << "starting update" << endl;
 	//transform hands
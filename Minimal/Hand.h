@@ -3,7 +3,6 @@
 #include "Model.h"
 #include "Shader.h"
 #include "Player.h"
-#include "Leap\Leap.h"
 #include "OVRUTIL.h"
 #include "LibOVR/OVR_CAPI.h"
 #include "LibOVR/OVR_CAPI_GL.h"
@@ -19,21 +18,13 @@ public:
 	glm::mat4 toWorld;
 	glm::vec3 min;
 	glm::vec3 max;
-	ovrInputState inputState;
 	ovrPosef HandPose;
 	bool isLeap = false;
-	int handiness = 0;
-	Hand(ovrSession = NULL, long long = 0, bool left = false);
+	Hand(const ovrPosef & pose);
 	Hand(bool isleap = false);
 	~Hand();
 	bool update();
-	void pollOculusInput(ovrSession _session, long long frame);
-	void pollLeapInput(Leap::Controller & controller, Player & player);
 	void calcAABB();
 	void Draw(Shader shader);
-private:
-	double displayMidpointSeconds;
-	ovrTrackingState trackState;
-
 };
 #endif
@@ -0,0 +1,192 @@
+#include "InputDevice.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+static const float PI = 3.14159265f;
+
+// where the tracked heads and hands sit along the table, matching the offsets the
+// Rift and Leap devices put their poses at
+#define HEAD_DISTANCE 2.5f
+#define HAND_DISTANCE 2.2f
+
+static ovrPosef makePose(float x, float y, float z, float yaw)
+{
+	ovrPosef pose;
+	pose.Position.x = x;
+	pose.Position.y = y;
+	pose.Position.z = z;
+	pose.Orientation.x = 0.0f;
+	pose.Orientation.y = std::sin(yaw / 2.0f);
+	pose.Orientation.z = 0.0f;
+	pose.Orientation.w = std::cos(yaw / 2.0f);
+	return pose;
+}
+
+// the LEAP player faces back up the table
+static float facing(int player)
+{
+	return (player == LEAP) ? PI : 0.0f;
+}
+
+static float side(int player)
+{
+	return (player == LEAP) ? -1.0f : 1.0f;
+}
+
+StubDevice::StubDevice(int player)
+{
+	standing.head = makePose(0.0f, 0.0f, side(player) * HEAD_DISTANCE, facing(player));
+	standing.hand = makePose(side(player) * 0.2f, -0.3f, side(player) * HAND_DISTANCE, facing(player));
+}
+
+bool StubDevice::poll(long long, TrackedPoses & poses)
+{
+	poses = standing;
+	return true;
+}
+
+ScriptedDevice::ScriptedDevice(int player, double frameRate) : player(player), frameRate(frameRate)
+{
+}
+
+bool ScriptedDevice::poll(long long frame, TrackedPoses & poses)
+{
+	// the time comes from the frame number alone, never the clock
+	float t = (float)(frame / frameRate);
+	float phase = (player == LEAP) ? 1.0f : 0.0f;
+	float z = side(player);
+
+	// hand sweeps across the table and dips, wobbling a little in yaw like a real swing
+	float handX = 0.7f * std::sin(t * 1.7f + phase);
+	poses.hand = makePose(handX, -0.3f + 0.3f * std::sin(t * 0.9f + phase),
+		z * (HAND_DISTANCE + 0.1f * std::sin(t * 2.3f)), facing(player) + 0.3f * std::sin(t * 1.1f));
+
+	// head sways and turns toward the hand
+	poses.head = makePose(0.1f * std::sin(t * 0.5f + phase), 0.02f * std::sin(t * 1.3f),
+		z * HEAD_DISTANCE, facing(player) - 0.2f * handX);
+	return true;
+}
+
+static void putFloat(char * out, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 4; ++i)
+		out[i] = (char)((bits >> (i * 8)) & 0xff);
+}
+
+static float getFloat(const char * in)
+{
+	const unsigned char * bytes = (const unsigned char *)in;
+	uint32_t bits = 0;
+	for (int i = 0; i < 4; ++i)
+		bits |= (uint32_t)bytes[i] << (i * 8);
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void putPose(char * out, const ovrPosef & pose)
+{
+	const float values[7] = { pose.Position.x, pose.Position.y, pose.Position.z,
+		pose.Orientation.x, pose.Orientation.y, pose.Orientation.z, pose.Orientation.w };
+	for (int i = 0; i < 7; ++i)
+		putFloat(out + i * 4, values[i]);
+}
+
+static ovrPosef getPose(const char * in)
+{
+	ovrPosef pose;
+	pose.Position.x = getFloat(in);
+	pose.Position.y = getFloat(in + 4);
+	pose.Position.z = getFloat(in + 8);
+	pose.Orientation.x = getFloat(in + 12);
+	pose.Orientation.y = getFloat(in + 16);
+	pose.Orientation.z = getFloat(in + 20);
+	pose.Orientation.w = getFloat(in + 24);
+	return pose;
+}
+
+bool RecordedDevice::open(const std::string & path)
+{
+	FILE * file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char header[8];
+	bool valid = std::fread(header, 1, sizeof(header), file) == sizeof(header)
+		&& std::memcmp(header, INPUT_RECORD_MAGIC, 4) == 0
+		&& (unsigned char)header[4] == INPUT_RECORD_VERSION;
+
+	frames.clear();
+	char frame[INPUT_RECORD_FLOATS * 4];
+	while (valid && std::fread(frame, 1, sizeof(frame), file) == sizeof(frame))
+	{
+		TrackedPoses poses;
+		poses.head = getPose(frame);
+		poses.hand = getPose(frame + 28);
+		frames.push_back(poses);
+	}
+	std::fclose(file);
+	return valid && !frames.empty();
+}
+
+bool RecordedDevice::poll(long long frame, TrackedPoses & poses)
+{
+	if (frames.empty())
+		return false;
+	poses = frames[(size_t)(frame % (long long)frames.size())];
+	return true;
+}
+
+InputRecorder::InputRecorder(InputDevice & device) : device(device), file(NULL)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+	if (file)
+		std::fclose(file);
+}
+
+bool InputRecorder::open(const std::string & path)
+{
+	if (file)
+		std::fclose(file);
+	file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	char header[8] = {};
+	std::memcpy(header, INPUT_RECORD_MAGIC, 4);
+	header[4] = (char)INPUT_RECORD_VERSION;
+	std::fwrite(header, 1, sizeof(header), file);
+	return true;
+}
+
+bool InputRecorder::poll(long long frame, TrackedPoses & poses)
+{
+	if (!device.poll(frame, poses))
+		return false;
+
+	if (file)
+	{
+		char out[INPUT_RECORD_FLOATS * 4];
+		putPose(out, poses.head);
+		putPose(out + 28, poses.hand);
+		std::fwrite(out, 1, sizeof(out), file);
+	}
+	return true;
+}
+
+void InputRecorder::vibrate(float amplitude)
+{
+	device.vibrate(amplitude);
+}
+
+void InputRecorder::recenter()
+{
+	device.recenter();
+}
@@ -0,0 +1,101 @@
+#ifndef INPUT_DEVICE_H
+#define INPUT_DEVICE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <LibOVR/OVR_CAPI.h>
+
+#include "SerializablePose.h"
+
+// how many frames a second ScriptedDevice assumes when it is not told
+#define SCRIPTED_FRAME_RATE 90
+
+// file written by InputRecorder: the magic and a version as little endian u32s, then
+// per frame the head and hand poses as 14 little endian floats, position then orientation
+#define INPUT_RECORD_MAGIC "VRIN"
+#define INPUT_RECORD_VERSION 1
+#define INPUT_RECORD_FLOATS 14
+
+// where the local player's head and hand are for one frame
+struct TrackedPoses
+{
+	ovrPosef head;
+	ovrPosef hand;
+};
+
+// a source of tracked poses, the Rift, a Leap, or something that stands in for them
+// so the game runs without either. all the game reads from a device goes through here.
+// poses are in game space: the OCULUS player stands at the +z end of the table facing
+// down it and the LEAP player at the -z end facing back.
+class InputDevice
+{
+public:
+	virtual ~InputDevice() { }
+
+	// poses predicted for when frame is displayed, returns false if nothing is tracked
+	// and leaves poses as they were
+	virtual bool poll(long long frame, TrackedPoses & poses) = 0;
+
+	// rumbles the hand holding the paddle, 0 stops it, devices that can't ignore it
+	virtual void vibrate(float) { }
+
+	// makes where the player stands now the origin
+	virtual void recenter() { }
+};
+
+// always reports a player standing still at their end of the table
+class StubDevice : public InputDevice
+{
+public:
+	StubDevice(int player = OCULUS);
+	bool poll(long long frame, TrackedPoses & poses) override;
+
+private:
+	TrackedPoses standing;
+};
+
+// moves the head and hand along fixed paths driven only by the frame number, so every
+// run at the same frame rate sees exactly the same poses
+class ScriptedDevice : public InputDevice
+{
+public:
+	ScriptedDevice(int player = OCULUS, double frameRate = SCRIPTED_FRAME_RATE);
+	bool poll(long long frame, TrackedPoses & poses) override;
+
+private:
+	int player;
+	double frameRate;
+};
+
+// plays back poses written by InputRecorder, one per frame, looping at the end
+class RecordedDevice : public InputDevice
+{
+public:
+	bool open(const std::string & path);
+	bool poll(long long frame, TrackedPoses & poses) override;
+
+	size_t frameCount() const { return frames.size(); }
+
+private:
+	std::vector<TrackedPoses> frames;
+};
+
+// passes another device through and writes every frame it tracked to a file for RecordedDevice
+class InputRecorder : public InputDevice
+{
+public:
+	InputRecorder(InputDevice & device);
+	~InputRecorder();
+
+	bool open(const std::string & path);
+	bool poll(long long frame, TrackedPoses & poses) override;
+	void vibrate(float amplitude) override;
+	void recenter() override;
+
+private:
+	InputDevice & device;
+	FILE * file;
+};
+
+#endif
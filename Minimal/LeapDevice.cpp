@@ -0,0 +1,25 @@
+#include "LeapDevice.h"
+
+bool LeapDevice::poll(long long, TrackedPoses & poses)
+{
+	Leap::Frame latest = controller.frame(0);
+	if (!latest.isValid() || latest.hands().count() == 0)
+		return false;
+
+	Leap::Hand hand = *latest.hands().begin();
+	if (!hand.isValid())
+		return false;
+
+	// the palm above the controller, moved to the -z end of the table
+	Leap::Vector pos = hand.palmPosition();
+	poses.hand.Position.x = -pos.x / 100.0f;
+	poses.hand.Position.y = pos.y / 100.0f - 1.0f;
+	poses.hand.Position.z = -pos.z / 100.0f - 2.3f;
+
+	poses.hand.Orientation.x = hand.palmNormal().x;
+	poses.hand.Orientation.y = -hand.palmNormal().y;
+	poses.hand.Orientation.z = hand.palmNormal().z;
+	poses.hand.Orientation.w = 0;
+
+	return true;
+}
@@ -0,0 +1,19 @@
+#ifndef LEAP_DEVICE_H
+#define LEAP_DEVICE_H
+
+#include "Leap/Leap.h"
+
+#include "InputDevice.h"
+
+// the first hand over a Leap Motion controller, for the LEAP player
+// the Leap can't see the player's head, poll leaves it as it was
+class LeapDevice : public InputDevice
+{
+public:
+	bool poll(long long frame, TrackedPoses & poses) override;
+
+private:
+	Leap::Controller controller;
+};
+
+#endif
@@ -0,0 +1,393 @@
+#include "NetworkClient.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+#include <new>
+#include <iostream>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include "rpc/client.h"
+#include "rpc/rpc_error.h"
+#include "UdpSocket.h"
+#include "SnapshotDelta.h"
+#include "Simulation.h"
+
+using namespace std;
+
+NetworkClient::NetworkClient(int roomId, int player, bool useUdp) : roomId(roomId), player(player), useUdp(useUdp), running(false), ready(false), failed(false)
+{
+}
+
+NetworkClient::~NetworkClient()
+{
+	stop();
+}
+
+void * NetworkClient::operator new(size_t size)
+{
+#ifdef _WIN32
+	void * memory = _aligned_malloc(size, alignof(NetworkClient));
+#else
+	void * memory = NULL;
+	if (posix_memalign(&memory, alignof(NetworkClient), size) != 0)
+		memory = NULL;
+#endif
+	if (!memory)
+		throw bad_alloc();
+	return memory;
+}
+
+void NetworkClient::operator delete(void * memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void NetworkClient::start(const s_Pose & head, const s_Pose & hand)
+{
+	if (running)
+		return;
+	running = true;
+	worker = thread(&NetworkClient::run, this, head, hand);
+}
+
+void NetworkClient::stop()
+{
+	running = false;
+	if (worker.joinable())
+		worker.join();
+}
+
+bool NetworkClient::isReady() const
+{
+	return ready;
+}
+
+bool NetworkClient::hasFailed() const
+{
+	return failed;
+}
+
+string NetworkClient::failure() const
+{
+	return failed ? failureReason : string();
+}
+
+void NetworkClient::fail(const string & reason)
+{
+	cerr << reason << endl;
+	failureReason = reason;
+	failed = true;
+}
+
+bool NetworkClient::sendPlayerState(const s_PlayerState & state)
+{
+	return outgoing.push(state);
+}
+
+bool NetworkClient::receiveSnapshot(s_WorldSnapshot & snapshot)
+{
+	return incoming.pop(snapshot);
+}
+
+void NetworkClient::run(s_Pose head, s_Pose hand)
+{
+	try
+	{
+		rpc::client client(SERVER_IP, SERVER_PORT);
+		client.set_timeout(CALL_TIMEOUT_MS);
+		fetchMethodTable(client);
+
+		// join the room and initialize the poses for this player on the server,
+		// state uploads are notifications so the server never answers them.
+		// a missing room or someone else in the seat means this client can't play at all
+		uint64_t udpToken;
+		try
+		{
+			udpToken = client.call(method("joinRoom"), roomId, player).as<uint64_t>();
+		}
+		catch (rpc::rpc_error& e)
+		{
+			fail("Unable to join room " + to_string(roomId) + ": " + e.get_error().get().as<string>());
+			return;
+		}
+		client.send(method("setPose"), roomId, player, HEAD, head);
+		client.send(method("setPose"), roomId, player, HAND, hand);
+
+		// let the server know this player is ready and wait for the other one
+		client.call(method(player == LEAP ? "leapReady" : "oculusReady"), roomId);
+		const string waitForPeers = method("waitForPeers");
+		while (running)
+		{
+			chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+			try
+			{
+				if (client.call(waitForPeers, roomId, player, PEER_WAIT_MS).as<bool>())
+					break;
+			}
+			catch (rpc::timeout&)
+			{
+				// a slow server isn't a lost one, ask again unless we're stopping
+				continue;
+			}
+			this_thread::sleep_until(asked + chrono::milliseconds(LOBBY_RETRY_MS));
+		}
+		if (running)
+		{
+			ready = true;
+			cout << "Starting program!" << endl;
+
+			// the rpc session stays open for control calls even when poses go over udp
+			if (!useUdp || !syncOverUdp(udpToken))
+				syncOverRpc(client);
+		}
+
+		// give the seat back so this player can join it again straight away
+		try
+		{
+			client.call(method("leaveRoom"), roomId, player, udpToken);
+		}
+		catch (exception&)
+		{
+			// an older or unreachable server, the seat times out there instead
+		}
+	}
+	catch (exception& e)
+	{
+		fail(string("Lost connection to the server: ") + e.what());
+	}
+}
+
+void NetworkClient::fetchMethodTable(rpc::client & client)
+{
+	try
+	{
+		vector<string> names = client.call("getMethodTable").as<vector<string>>();
+		for (size_t i = 0; i < names.size(); ++i)
+			methodIds[names[i]] = methodId((int)i);
+	}
+	catch (rpc::rpc_error&)
+	{
+		cerr << "Server has no method ids, calling methods by name" << endl;
+	}
+}
+
+string NetworkClient::method(const string & name) const
+{
+	map<string, string>::const_iterator it = methodIds.find(name);
+	return (it != methodIds.end()) ? it->second : name;
+}
+
+bool NetworkClient::latestState(s_PlayerState & state)
+{
+	bool haveState = false;
+	while (outgoing.pop(state))
+		haveState = true;
+	return haveState;
+}
+
+void NetworkClient::syncOverRpc(rpc::client & client)
+{
+	const string subscribeWorld = method("subscribeWorld");
+	const string pushPlayerState = method("pushPlayerState");
+
+	// keep one subscription outstanding, the server parks it until the world changes or
+	// SUBSCRIBE_TIMEOUT_MS runs out. an unchanged answer any sooner means the server had
+	// no worker to park it on, so each one doubles the wait before the next, up to
+	// SUBSCRIBE_MAX_BACKOFF_MS. the world changes at most once a tick, so no subscription
+	// goes out sooner than a tick after the last one
+	const chrono::nanoseconds tick(1000000000 / TICK_RATE);
+	chrono::nanoseconds backoff(0);
+	unsigned int worldTick = 0;
+	unsigned int sequence = 0;
+	chrono::steady_clock::time_point subscribedAt = chrono::steady_clock::now();
+	future<RPCLIB_MSGPACK::object_handle> pending =
+		client.async_call(subscribeWorld, roomId, player, worldTick, SUBSCRIBE_TIMEOUT_MS);
+	bool subscribed = true;
+
+	while (running)
+	{
+		// the server drops uploads that arrive after a newer one, 0 is never newer
+		s_PlayerState state;
+		if (latestState(state))
+		{
+			if (++sequence == 0)
+				++sequence;
+			client.send(pushPlayerState, roomId, player, sequence, state);
+		}
+
+		if (!subscribed)
+		{
+			// input keeps going out while the next subscription waits
+			chrono::steady_clock::time_point now = chrono::steady_clock::now();
+			chrono::steady_clock::time_point due = subscribedAt + max(tick, backoff);
+			if (now < due)
+			{
+				this_thread::sleep_until(min(due, now + chrono::milliseconds(NETWORK_POLL_MS)));
+				continue;
+			}
+			subscribedAt = now;
+			pending = client.async_call(subscribeWorld, roomId, player, worldTick, SUBSCRIBE_TIMEOUT_MS);
+			subscribed = true;
+		}
+
+		// async calls ignore the client's timeout, give up on a lost answer the same way
+		if (pending.wait_for(chrono::milliseconds(NETWORK_POLL_MS)) != future_status::ready)
+		{
+			if (chrono::steady_clock::now() - subscribedAt > chrono::milliseconds(CALL_TIMEOUT_MS))
+			{
+				cerr << "World subscription timed out, subscribing again" << endl;
+				subscribed = false;
+			}
+			continue;
+		}
+		subscribed = false;
+		bool parked = chrono::steady_clock::now() - subscribedAt >= chrono::milliseconds(SUBSCRIBE_TIMEOUT_MS / 2);
+
+		try
+		{
+			s_WorldSnapshot snapshot = pending.get().as<s_WorldSnapshot>();
+			if (snapshot.changed || parked)
+				backoff = chrono::nanoseconds(0);
+			else
+				backoff = min<chrono::nanoseconds>(max(backoff * 2, tick), chrono::milliseconds(SUBSCRIBE_MAX_BACKOFF_MS));
+
+			if (snapshot.changed)
+			{
+				worldTick = snapshot.tick;
+				if (!incoming.push(snapshot))
+					cerr << "Render thread is behind, dropping a world snapshot" << endl;
+			}
+		}
+		catch (rpc::rpc_error& e)
+		{
+			cerr << "Unable to sync world state with server!" << endl;
+			cerr << "Reason: " << e.what() << endl;
+		}
+	}
+}
+
+bool NetworkClient::syncOverUdp(uint64_t token)
+{
+	UdpSocket socket;
+	UdpEndpoint server;
+	if (!socket.open(0) || !UdpSocket::resolve(SERVER_IP, SERVER_UDP_PORT, server))
+	{
+		cerr << "Unable to open a udp socket, sending poses over rpc" << endl;
+		return false;
+	}
+
+	// reused for every datagram so a steady stream of them never touches the heap,
+	// the deltas keep their capacity from one snapshot to the next
+	RPCLIB_MSGPACK::sbuffer buffer;
+	DatagramReader datagrams;
+	s_UdpSnapshots snapshots;
+	char datagram[UDP_MAX_DATAGRAM];
+	UdpEndpoint from;
+
+	s_UdpInput input;
+	input.roomId = roomId;
+	input.player = player;
+	input.token = token;
+	input.sequence = 0;
+	input.ackSequence = 0;
+	input.keyframe = false;
+
+	// decoded snapshots by sequence number, the server sends deltas against one of these
+	unsigned int historySequence[UDP_HISTORY] = {};
+	s_WorldSnapshot history[UDP_HISTORY];
+	static const s_WorldSnapshot empty = s_WorldSnapshot();
+
+	unsigned int worldTick = 0;
+
+	while (running)
+	{
+		if (latestState(input.state))
+		{
+			++input.sequence;
+			buffer.clear();
+			RPCLIB_MSGPACK::pack(buffer, input);
+			socket.sendTo(server, buffer.data(), buffer.size());
+		}
+
+		int timeoutMs = NETWORK_POLL_MS;
+		int size;
+		while ((size = socket.receiveFrom(datagram, sizeof(datagram), from, timeoutMs)) > 0)
+		{
+			timeoutMs = 0;
+			if (from != server)
+				continue;
+
+			try
+			{
+				RPCLIB_MSGPACK::object message;
+				if (!datagrams.read(datagram, size, message))
+					continue;
+				message.convert(snapshots);
+			}
+			catch (exception&)
+			{
+				continue;
+			}
+
+			// drop datagrams that arrived after a newer one
+			if (input.ackSequence != 0 && !sequenceNewer(snapshots.sequence, input.ackSequence))
+				continue;
+
+			// a delta against a snapshot we don't have is useless, ask for a keyframe
+			const s_WorldSnapshot * base = &empty;
+			if (snapshots.baseSequence != 0)
+			{
+				if (historySequence[snapshots.baseSequence % UDP_HISTORY] != snapshots.baseSequence)
+				{
+					input.keyframe = true;
+					continue;
+				}
+				base = &history[snapshots.baseSequence % UDP_HISTORY];
+			}
+
+			// newest first, the repeats fill in for datagrams that never arrived
+			BitReader reader(snapshots.deltas.data(), snapshots.deltas.size());
+			uint32_t count;
+			if (!reader.readVarUint(count))
+				continue;
+			s_WorldSnapshot decoded[UDP_REDUNDANCY];
+			unsigned int sequences[UDP_REDUNDANCY];
+			int valid = 0;
+			for (uint32_t i = 0; i < count && i < UDP_REDUNDANCY; ++i)
+			{
+				uint32_t behind;
+				if (!reader.readVarUint(behind) || !decodeSnapshotDelta(reader, decoded[valid], *base))
+					break;
+				sequences[valid++] = snapshots.sequence - behind;
+			}
+			if (valid == 0)
+				continue;
+
+			for (int i = valid - 1; i >= 0; --i)
+			{
+				historySequence[sequences[i] % UDP_HISTORY] = sequences[i];
+				history[sequences[i] % UDP_HISTORY] = decoded[i];
+
+				if (worldTick != 0 && !sequenceNewer(decoded[i].tick, worldTick))
+					continue;
+				worldTick = decoded[i].tick;
+				if (!incoming.push(decoded[i]))
+					cerr << "Render thread is behind, dropping a world snapshot" << endl;
+			}
+
+			// acked with the next input, the server deltas against it from then on
+			input.ackSequence = snapshots.sequence;
+			if (snapshots.baseSequence == 0)
+				input.keyframe = false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef NETWORK_CLIENT_H
+#define NETWORK_CLIENT_H
+
+#include <atomic>
+#include <thread>
+#include <map>
+#include <string>
+
+#include "SerializablePose.h"
+#include "SpscRing.h"
+
+namespace rpc { class client; }
+
+// longest the network thread sleeps between checks for outgoing input, in milliseconds
+#define NETWORK_POLL_MS 2
+#define SUBSCRIBE_TIMEOUT_MS 1000
+
+// longest the client waits between world subscriptions the server couldn't park
+#define SUBSCRIBE_MAX_BACKOFF_MS 250
+#define PEER_WAIT_MS 1000
+
+// a call unanswered this long past the longest long poll gives up, so stop() never
+// waits on a server that went quiet
+#define CALL_TIMEOUT_MS 1500
+
+// a server with all its workers busy answers long polls at once, so the client waits at
+// least this long between lobby checks
+#define LOBBY_RETRY_MS 100
+#define NETWORK_RING_SIZE 16
+
+// owns the connection to the server on its own thread so the render loop never waits on a socket
+// the render thread hands it the local player's input and picks up world snapshots,
+// both through lock-free rings. with useUdp the poses go over the server's udp channel
+// once the match starts and the server pushes snapshots there as the room changes,
+// falling back to long polling over rpc if the socket can't be opened.
+class NetworkClient
+{
+public:
+	NetworkClient(int roomId, int player, bool useUdp = false);
+	~NetworkClient();
+
+	// the rings keep their indices on separate cache lines, plain new only honours
+	// that alignment from C++17 on, so clients are allocated aligned
+	static void * operator new(size_t size);
+	static void operator delete(void * memory);
+
+	// connects, joins the room and readies up in the background
+	void start(const s_Pose & head, const s_Pose & hand);
+	void stop();
+
+	// true once both players of the room are ready
+	bool isReady() const;
+
+	// true once the client gave up, because its seat was taken or the server went away,
+	// failure() then says why
+	bool hasFailed() const;
+	std::string failure() const;
+
+	// render thread side, neither call blocks
+	bool sendPlayerState(const s_PlayerState & state);
+	bool receiveSnapshot(s_WorldSnapshot & snapshot);
+
+private:
+	void run(s_Pose head, s_Pose hand);
+	void syncOverRpc(rpc::client & client);
+	// token is the seat's, as joinRoom answered it
+	bool syncOverUdp(uint64_t token);
+
+	// stops the network thread for good and tells the render thread why
+	void fail(const std::string & reason);
+
+	// drains the outgoing ring, only the newest input matters
+	bool latestState(s_PlayerState & state);
+
+	// fetches the compact method ids, servers without them keep getting names
+	void fetchMethodTable(rpc::client & client);
+	std::string method(const std::string & name) const;
+
+	int roomId;
+	int player;
+	bool useUdp;
+	std::map<std::string, std::string> methodIds;
+
+	std::thread worker;
+	std::atomic<bool> running;
+	std::atomic<bool> ready;
+
+	// written once by the network thread before failed is set
+	std::string failureReason;
+	std::atomic<bool> failed;
+
+	SpscRing<s_PlayerState, NETWORK_RING_SIZE> outgoing;
+	SpscRing<s_WorldSnapshot, NETWORK_RING_SIZE> incoming;
+};
+
+#endif
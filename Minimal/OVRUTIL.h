@@ -7,6 +7,7 @@
 
 #include <LibOVR/OVR_CAPI.h>
 #include <LibOVR/OVR_CAPI_GL.h>
+#include <cstring>
 
 
 #include <glm/glm.hpp>
@@ -0,0 +1,30 @@
+#include "OvrDevice.h"
+
+OvrDevice::OvrDevice(ovrSession session, bool leftHanded) : session(session), hand(leftHanded ? ovrHand_Left : ovrHand_Right)
+{
+}
+
+bool OvrDevice::poll(long long frame, TrackedPoses & poses)
+{
+	double displayMidpointSeconds = ovr_GetPredictedDisplayTime(session, frame);
+	ovrTrackingState trackState = ovr_GetTrackingState(session, displayMidpointSeconds, ovrTrue);
+
+	// the head as the sdk reports it, the game draws from the eye poses it renders with.
+	// only the hand is moved up the table
+	poses.head = trackState.HeadPose.ThePose;
+	poses.hand = trackState.HandPoses[hand].ThePose;
+	poses.hand.Position.z += RIFT_TABLE_OFFSET;
+
+	// the sdk keeps reporting the last known pose while tracking is lost, which beats freezing
+	return true;
+}
+
+void OvrDevice::vibrate(float amplitude)
+{
+	ovr_SetControllerVibration(session, hand == ovrHand_Left ? ovrControllerType_LTouch : ovrControllerType_RTouch, 0.0f, amplitude);
+}
+
+void OvrDevice::recenter()
+{
+	ovr_RecenterTrackingOrigin(session);
+}
@@ -0,0 +1,26 @@
+#ifndef OVR_DEVICE_H
+#define OVR_DEVICE_H
+
+#include <LibOVR/OVR_CAPI.h>
+
+#include "InputDevice.h"
+
+// the Rift tracks the player's hand this far up the table from its origin
+#define RIFT_TABLE_OFFSET 2.5f
+
+// head and touch controller tracked by the Rift, for the OCULUS player
+class OvrDevice : public InputDevice
+{
+public:
+	OvrDevice(ovrSession session, bool leftHanded = false);
+
+	bool poll(long long frame, TrackedPoses & poses) override;
+	void vibrate(float amplitude) override;
+	void recenter() override;
+
+private:
+	ovrSession session;
+	int hand;
+};
+
+#endif
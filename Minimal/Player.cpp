@@ -14,7 +14,7 @@ void Player::Draw(Shader shader, int playernum) {
 	hand->Draw(shader);
 }
 
-void Player::update(ovrSession _session, long long frame) {
+void Player::update() {
 	hand->update();
 	if (hand->isLeap) {
 		head->HeadPose = hand->HandPose;
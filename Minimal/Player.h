@@ -10,7 +10,7 @@ public:
 	Player();
 	Player(int playernum, Hand * phand);
 	void Draw(Shader shader, int playernum);
-	void update(ovrSession, long long);
+	void update();
 	~Player();
 	int playerNum;
 	Head * head;
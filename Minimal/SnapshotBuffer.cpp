@@ -0,0 +1,144 @@
+#include "SnapshotBuffer.h"
+
+SnapshotBuffer::SnapshotBuffer(double delay) : delay(delay), clockOffset(0.0), hasOffset(false)
+{
+}
+
+void SnapshotBuffer::setDelay(double seconds)
+{
+	delay = seconds;
+}
+
+void SnapshotBuffer::push(double serverTime, const ovrPosef & head, const ovrPosef & hand, const BallState & ball, double localTime)
+{
+	// drop duplicates and anything that arrived out of order
+	if (!snapshots.empty() && serverTime <= snapshots.back().serverTime)
+		return;
+
+	// the fastest delivery is the best guess of the clock offset, drift slowly
+	// toward slower ones so a change in route doesn't leave it stale forever
+	double offset = localTime - serverTime;
+	if (!hasOffset || offset < clockOffset)
+		clockOffset = offset;
+	else
+		clockOffset += (offset - clockOffset) * 0.01;
+	hasOffset = true;
+
+	PoseSnapshot snapshot;
+	snapshot.serverTime = serverTime;
+	snapshot.head = head;
+	snapshot.hand = hand;
+	snapshot.ball = ball;
+	snapshots.push_back(snapshot);
+
+	while (snapshots.size() > SNAPSHOT_BUFFER_SIZE)
+		snapshots.pop_front();
+}
+
+double SnapshotBuffer::renderTime(double localTime) const
+{
+	return localTime - clockOffset - delay;
+}
+
+bool SnapshotBuffer::sample(double localTime, ovrPosef & head, ovrPosef & hand) const
+{
+	if (snapshots.empty())
+		return false;
+
+	double renderTime = this->renderTime(localTime);
+
+	// older than anything buffered, show the oldest
+	if (snapshots.size() == 1 || renderTime <= snapshots.front().serverTime)
+	{
+		head = snapshots.front().head;
+		hand = snapshots.front().hand;
+		return true;
+	}
+
+	// interpolate between the two snapshots around the render time
+	for (size_t i = 1; i < snapshots.size(); ++i)
+	{
+		const PoseSnapshot & a = snapshots[i - 1];
+		const PoseSnapshot & b = snapshots[i];
+		if (renderTime <= b.serverTime)
+		{
+			float t = (float)((renderTime - a.serverTime) / (b.serverTime - a.serverTime));
+			head = interpolate(a.head, b.head, t);
+			hand = interpolate(a.hand, b.hand, t);
+			return true;
+		}
+	}
+
+	// ran out of snapshots, keep moving along the last known motion for a bit
+	const PoseSnapshot & a = snapshots[snapshots.size() - 2];
+	const PoseSnapshot & b = snapshots.back();
+	double ahead = renderTime - b.serverTime;
+	if (ahead > MAX_POSE_EXTRAPOLATION)
+		ahead = MAX_POSE_EXTRAPOLATION;
+	float t = (float)(ahead / (b.serverTime - a.serverTime));
+	head = extrapolate(a.head, b.head, t);
+	hand = extrapolate(a.hand, b.hand, t);
+	return true;
+}
+
+bool SnapshotBuffer::sampleBall(double localTime, BallState & ball) const
+{
+	if (snapshots.empty())
+		return false;
+
+	double renderTime = this->renderTime(localTime);
+	if (snapshots.size() == 1 || renderTime <= snapshots.front().serverTime)
+	{
+		ball = snapshots.front().ball;
+		return true;
+	}
+
+	// between two snapshots the ball moves in a straight line, apart from a serve
+	for (size_t i = 1; i < snapshots.size(); ++i)
+	{
+		const PoseSnapshot & a = snapshots[i - 1];
+		const PoseSnapshot & b = snapshots[i];
+		if (renderTime <= b.serverTime)
+		{
+			float t = (float)((renderTime - a.serverTime) / (b.serverTime - a.serverTime));
+			if (glm::length(b.ball.position - a.ball.position) > BALL_SNAP_DISTANCE)
+			{
+				ball = (t < 0.5f) ? a.ball : b.ball;
+				return true;
+			}
+			ball = a.ball;
+			ball.position = glm::mix(a.ball.position, b.ball.position, t);
+			ball.velocity = glm::mix(a.ball.velocity, b.ball.velocity, t);
+			return true;
+		}
+	}
+
+	// ran out of snapshots, let it fly on between the walls for a bit
+	ball = snapshots.back().ball;
+	double ahead = renderTime - snapshots.back().serverTime;
+	if (ahead > MAX_POSE_EXTRAPOLATION)
+		ahead = MAX_POSE_EXTRAPOLATION;
+	moveBall(ball, (float)ahead);
+	return true;
+}
+
+ovrPosef SnapshotBuffer::interpolate(const ovrPosef & a, const ovrPosef & b, float t)
+{
+	ovrPosef ret;
+	ret.Position = ovr::fromGlm(glm::mix(ovr::toGlm(a.Position), ovr::toGlm(b.Position), t));
+	ret.Orientation = ovr::fromGlm(glm::slerp(ovr::toGlm(a.Orientation), ovr::toGlm(b.Orientation), t));
+	return ret;
+}
+
+// continues the motion from a to b past b by t times the a-b interval,
+// only the position moves, the orientation is held at b
+ovrPosef SnapshotBuffer::extrapolate(const ovrPosef & a, const ovrPosef & b, float t)
+{
+	vec3 from = ovr::toGlm(a.Position);
+	vec3 to = ovr::toGlm(b.Position);
+
+	ovrPosef ret;
+	ret.Position = ovr::fromGlm(to + (to - from) * t);
+	ret.Orientation = b.Orientation;
+	return ret;
+}
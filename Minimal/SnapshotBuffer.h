@@ -0,0 +1,61 @@
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include <deque>
+#include "OVRUTIL.h"
+#include "Simulation.h"
+
+// how far behind the newest snapshot remote players are drawn, in seconds
+#define INTERP_DELAY 0.1
+// longest a remote pose is dead reckoned once snapshots stop arriving, in seconds
+#define MAX_POSE_EXTRAPOLATION 0.2
+// snapshots kept around for interpolation
+#define SNAPSHOT_BUFFER_SIZE 32
+// a ball that moved further than this between two snapshots was served again, it jumps
+#define BALL_SNAP_DISTANCE 0.5f
+
+// remote head and hand pose and the ball stamped with the server's clock
+struct PoseSnapshot
+{
+	double serverTime;
+	ovrPosef head;
+	ovrPosef hand;
+	BallState ball;
+};
+
+// jitter buffer for a remote player: draws it a fixed delay in the past so there are
+// snapshots on both sides to interpolate between, and dead reckons for a short while
+// if the network stalls. the ball is drawn on the same timeline, so it reaches the
+// remote paddle when the paddle does.
+class SnapshotBuffer
+{
+public:
+	SnapshotBuffer(double delay = INTERP_DELAY);
+
+	// adds a snapshot received at localTime, both in seconds
+	void push(double serverTime, const ovrPosef & head, const ovrPosef & hand, const BallState & ball, double localTime);
+
+	// writes the poses to draw at localTime, returns false if nothing arrived yet
+	bool sample(double localTime, ovrPosef & head, ovrPosef & hand) const;
+
+	// writes the ball to draw at localTime, returns false if nothing arrived yet
+	bool sampleBall(double localTime, BallState & ball) const;
+
+	void setDelay(double seconds);
+
+private:
+	// server time drawn at localTime
+	double renderTime(double localTime) const;
+
+	static ovrPosef interpolate(const ovrPosef & a, const ovrPosef & b, float t);
+	static ovrPosef extrapolate(const ovrPosef & a, const ovrPosef & b, float t);
+
+	std::deque<PoseSnapshot> snapshots;
+	double delay;
+
+	// local clock minus server clock, tracks the smallest transit seen
+	double clockOffset;
+	bool hasOffset;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// fixed size lock-free queue between exactly one producer thread and one consumer thread
+// neither side ever waits, push fails when the ring is full and pop when it is empty.
+// N has to be a power of two.
+template <typename T, size_t N>
+class SpscRing
+{
+public:
+	SpscRing() : head(0), tail(0) { }
+
+	// producer side
+	bool push(const T & value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N)
+			return false;
+		items[t & (N - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T & value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		value = items[h & (N - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+	T items[N];
+
+	// kept on separate cache lines so the two threads don't fight over them
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
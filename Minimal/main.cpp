@@ -483,15 +483,20 @@ protected:
 using namespace irrklang;
 
 // server includes
-#include "rpc/client.h"
-#include "rpc/rpc_error.h"
 #include "SerializablePose.h"
+#include "NetworkClient.h"
+#include "SnapshotBuffer.h"
+#include "InputDevice.h"
+#include "OvrDevice.h"
 
 #define VERTEX_SHADER_PATH "shader.vert"
 #define FRAGMENT_SHADER_PATH "shader.frag"
 
 #define SYNC_INTERVAL 1
 
+// send poses over the server's udp channel instead of the rpc session
+#define POSES_OVER_UDP true
+
 glm::vec3 lightPos(0.0f, 0.2f, 0.0f);
 glm::vec3 lightAmbient(0.5f, 0.5f, 0.5f);
 glm::vec3 lightDiffuse(0.700000f, 0.500000f, 1.00000f);
@@ -508,17 +513,18 @@ class ExampleApp : public RiftApp
 	ISound* sheild;
 	ISoundEngine *SoundEngine;
 	GLint shaderProgram;
-	rpc::client* client;
-	ovrPosef remoteHeadPose;
-	ovrPosef remoteHandPose;
-	bool initialized = false;
-	bool ready = false;
+	NetworkClient * network = NULL;
+	bool failureShown = false;
+	InputDevice * input = NULL;
+	TrackedPoses tracked;
+	int roomId;
+	SnapshotBuffer remotePoses;
 	float deltaTime = 0.0f;
 	float lastFrame = 0.0f;
 	float currentFrame = 0.0f;
 
 public:
-	ExampleApp() { }
+	ExampleApp(int room = DEFAULT_ROOM) : roomId(room) { }
 
 protected:
 	
@@ -551,202 +557,119 @@ protected:
 		RiftApp::initGl();
 		glClearColor(0.0f, 0.0f, 0.5f, 1.0f);
 		glEnable(GL_DEPTH_TEST);
-		ovr_RecenterTrackingOrigin(_session);
+		input = new OvrDevice(_session);
+		input->recenter();
+		input->poll(frame, tracked);
 		shader = new Shader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
 		level = new Level();
 		ball = new Ball();
-		players.push_back(Player(players.size() + 1, new Hand(_session, frame, false)));
+		players.push_back(Player(players.size() + 1, new Hand(tracked.hand)));
 		players.push_back(Player(players.size() + 1, new Hand(true)));
 		initSound();
 
-		// start the client and initialize the poses for this player on the server
-		try
-		{
-			client = new rpc::client(SERVER_IP, SERVER_PORT);
-			client->call("setPose", OCULUS, HEAD, serializePose(players[0].head->HeadPose));
-			client->call("setPose", OCULUS, HAND, serializePose(players[0].hand->HandPose));
-		}
-		catch (rpc::rpc_error& e)
-		{
-			cerr << "Unable to set initial poses from server!" << endl;
-			cerr << "Reason: " << e.what() << endl;
-		}
+		// connect, join the room and ready up on the network thread
+		network = new NetworkClient(roomId, OCULUS, POSES_OVER_UDP);
+		network->start(serializePose(players[0].head->HeadPose), serializePose(players[0].hand->HandPose));
 	}
 
 	void shutdownGl() override {
 		//cubeScene.reset();
-		delete client;
+		delete network;
+		delete input;
 		exit(1);
 	}
 
-	bool intersect(int playernum) {
-		vec3 center = ball->calcCenterPoint();
-		vec3 min = players[playernum].hand->min;
-		vec3 max = players[playernum].hand->max;
-		//cout << "center: " << center.x << center.y << center.z << endl;
-		return (center.x >= min.x && center.x <= max.x) &&
-			(center.y >= min.y && center.y <= max.y) &&
-			(center.z >= min.z && center.z <= max.z);
+	// hand the local player's input to the network thread and apply any world snapshots
+	// it received since the last frame, never waits on the network
+	void syncWorld()
+	{
+		s_PlayerState local;
+		local.head = packPose(serializePose(players[0].head->HeadPose));
+		local.hand = packPose(serializePose(players[0].hand->HandPose));
+		network->sendPlayerState(local);
+
+		s_WorldSnapshot snapshot;
+		while (network->receiveSnapshot(snapshot))
+		{
+			remotePoses.push(snapshot.serverTimeMs / 1000.0,
+				deserializePose(unpackPose(snapshot.heads[LEAP])),
+				deserializePose(unpackPose(snapshot.hands[LEAP])),
+				deserializeBall(snapshot.ball, snapshot.lastPlayer),
+				glfwGetTime());
+		}
 	}
 
-	void update() 
+	// feedback for a paddle hit the server detected
+	void onBallHit(int playerNum)
 	{
-		currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+		cout << "Hit the ball for player " << playerNum << endl;
+		vec3 s = ball->calcCenterPoint();
+		sheild = SoundEngine->play3D("Assets/sound/clang.wav",
+			vec3df(s.x, s.y, s.z), false, false, true);
+		sheild->setMinDistance(1.0f);
+		if (playerNum == players[0].playerNum)
+			input->vibrate(1.0f);
+	}
 
-		try
+	void update() 
+	{
+		// without a seat or a server there is no match, turn the room red and stop syncing
+		if (network->hasFailed())
 		{
-			// let the server know oculus is ready
-			if (!initialized)
+			if (!failureShown)
 			{
-				cout << "Initializing oculus..." << endl;
-				client->call("oculusReady");
-				initialized = true;
+				cerr << "Not playing: " << network->failure() << endl;
+				glClearColor(0.5f, 0.0f, 0.0f, 1.0f);
+				failureShown = true;
 			}
-
-			// Check if all players are connected
-			if (!ready)
-			{
-				while (!(ready = client->call("checkConnection").as<bool>()));
-				cout << "Starting program!" << endl;
-			}
-		}
-		catch (rpc::rpc_error& e)
-		{
-			cerr << "Unable to ready oculus!" << endl;
-			cerr << "Reason: " << e.what() << endl;
+			return;
 		}
 
+		currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
 		bool triggerr = false;
 		SoundEngine->setListenerPosition(vec3df(headPose.Position.x, headPose.Position.y, headPose.Position.z),
 			vec3df(headPose.Orientation.x, headPose.Orientation.y, headPose.Orientation.z));
 		if(frame%30 == 0)
-			ovr_SetControllerVibration(_session, ovrControllerType_RTouch, 0.0f, 0.0f);
-
-		ball->update(deltaTime);
+			input->vibrate(0.0f);
 
-		// send an updated position for the ball
-		if (frame % SYNC_INTERVAL == 0)
-		{
-			try
-			{
-				client->async_call("setBallPose", serializeMat(ball->meshes[0].toWorld), 0);
-				client->async_call("setBallPose", serializeMat(ball->meshes[1].toWorld), 1);
-			}
-			catch (rpc::rpc_error& e)
-			{
-				cerr << "Unable to set ball position!" << endl;
-				cerr << "Reason: " << e.what() << endl;
-			}
-		}
-
-		/*if (ball->outOfBounds)
-		{
-			try
-			{
-				client->async_call("setLastPlayer", ball->lastPlayer);
-				ball->outOfBounds = false;
-			}
-			catch (rpc::rpc_error& e)
-			{
-				cerr << "Unable to set last player!" << endl;
-				cerr << "Reason: " << e.what() << endl;
-			}
-		}*/
-		
-		// TODO: set the update rates lower and interpolate to new remote positions
 		for (int i = 0; i < players.size(); ++i) {
 			if (players[i].hand->isLeap) 
 			{
 				// get an updated position from the server every certain number of frames
 				if (frame % SYNC_INTERVAL == 0)
 				{
-					//cout << "Getting remote pose" << endl;
-					try
-					{
-						remoteHeadPose = deserializePose(client->call("getPose", LEAP, HEAD).as<s_Pose>());
-						remoteHandPose = deserializePose(client->call("getPose", LEAP, HAND).as<s_Pose>());
-					}
-					catch (rpc::rpc_error& e)
-					{
-						cerr << "Unable to retrieve updated poses from server!" << endl;
-						cerr << "Reason: " << e.what() << endl;
-					}
+					//cout << "Syncing world state" << endl;
+					syncWorld();
 				}
 
 				//cout << "leap" << endl;
-				//set hand and head pose here fromw/e we got from network
-				// TODO: interpolate to new position for smoothness
-				players[i].head->HeadPose = remoteHeadPose;
-				players[i].hand->HandPose = remoteHandPose;
-				players[i].update(NULL, NULL);
+				// draw the remote player slightly in the past, interpolated between snapshots
+				remotePoses.sample(glfwGetTime(), players[i].head->HeadPose, players[i].hand->HandPose);
+				players[i].update();
 			}
 			else 
 			{
 				//cout << "not leap" << endl;
+				// the head is the eye pose this frame renders with, the device puts the
+				// hand at this player's end of the table, if it lost tracking the last one stays
+				input->poll(frame, tracked);
 				players[i].head->HeadPose = headPose;
-				players[i].hand->pollOculusInput(_session, frame);
-				players[i].hand->HandPose.Position.z += 2.5f;
-				players[i].update(NULL, NULL);
-
-				// send an updated position to the server every certain number of frames
-				if (frame % SYNC_INTERVAL == 0)
-				{
-					//cout << "Updating remote pose" << endl;
-					try
-					{
-						client->async_call("setPose", OCULUS, HAND, serializePose(players[i].hand->HandPose));
-						client->async_call("setPose", OCULUS, HEAD, serializePose(headPose));
-					}
-					catch (rpc::rpc_error& e)
-					{
-						cerr << "Unable to send updated poses to server!" << endl;
-						cerr << "Reason: " << e.what() << endl;
-					}
-				}
+				players[i].hand->HandPose = tracked.hand;
+				players[i].update();
 			}
+		}
 
-			// get the last player to hit
-			/*try
-			{
-				ball->lastPlayer = client->call("getLastPlayer").as<int>();
-			}
-			catch (rpc::rpc_error& e)
-			{
-				cerr << "Unable to get last player!" << endl;
-				cerr << "Reason: " << e.what() << endl;
-			}*/
-
-			// check for a collision between a player's hands and the ball
-			if (intersect(i) && ball->lastPlayer != players[i].playerNum)
-			{	
-				cout << "Hit the ball for player " << players[i].playerNum << endl;
-				vec3 s = ball->calcCenterPoint();
-				sheild = SoundEngine->play3D("Assets/sound/clang.wav",
-					vec3df(s.x, s.y, s.z), false, false, true);
-				sheild->setMinDistance(1.0f);
-				ball->velocity = -ball->velocity;
-
-				// update the last player to touch the ball
-				try
-				{
-					ball->lastPlayer = players[i].playerNum;
-					//client->async_call("setLastPlayer", players[i].playerNum);
-				}
-				catch (rpc::rpc_error& e)
-				{
-					cerr << "Unable to set last player!" << endl;
-					cerr << "Reason: " << e.what() << endl;
-				}
-
-				glm::quat direc = ovr::toGlm(players[i].hand->HandPose.Orientation);
-				vec3 reflect = glm::mat4_cast(direc)* vec4(0.0, 0.0, 1.0f, 1.0f);
-				cout << reflect.x << reflect.y << reflect.z << endl;
-				ball->velocity = reflect*-0.15f;
-				if(i = 1)
-					ovr_SetControllerVibration(_session, ovrControllerType_RTouch, 0.0f, 1.0f);
-			}
+		// the server owns the ball, it is drawn on the same delayed timeline as the
+		// remote player so it meets their paddle where the server saw it hit
+		BallState drawn;
+		if (remotePoses.sampleBall(glfwGetTime(), drawn))
+		{
+			if (drawn.lastPlayer != 0 && drawn.lastPlayer != ball->state.lastPlayer)
+				onBallHit(drawn.lastPlayer);
+			ball->setState(drawn);
 		}
 	}
 
@@ -787,7 +710,8 @@ int __stdcall WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 		if (!OVR_SUCCESS(ovr_Initialize(nullptr))) {
 			FAIL("Failed to initialize the Oculus SDK");
 		}
-		result = ExampleApp().run();
+		// the room to play in can be passed on the command line
+		result = ExampleApp(atoi(lpCmdLine)).run();
 	}
 	catch (std::exception & error) {
 		OutputDebugStringA(error.what());
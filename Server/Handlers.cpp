@@ -0,0 +1,180 @@
+#include "Handlers.h"
+
+#include <rpc/this_handler.h>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+
+using namespace std;
+
+RoomRegistry rooms;
+
+// long polls parked right now and how many may be
+static atomic<int> parkedPolls(0);
+static atomic<int> longPollCapacity(INT_MAX);
+
+void setLongPollCapacity(int polls)
+{
+	longPollCapacity = max(polls, 0);
+}
+
+// holds a place among the parked long polls for as long as the call runs
+class ParkedPoll
+{
+public:
+	ParkedPoll() : parked(++parkedPolls <= longPollCapacity) { }
+	~ParkedPoll() { --parkedPolls; }
+
+	// how long the poll may wait, at most maxMs, and not at all if it found no room
+	int timeout(int timeoutMs, int maxMs) const
+	{
+		return parked ? min(max(timeoutMs, 0), maxMs) : 0;
+	}
+
+private:
+	bool parked;
+};
+
+// looks up the room a call is scoped to, answering the call with an error if there is none
+static Room & roomFor(int roomId)
+{
+	Room * room = rooms.find(roomId);
+	if (!room)
+		rpc::this_handler().respond_error("No such room: " + to_string(roomId));
+	return *room;
+}
+
+// hands out a new room, returns -1 if the server is full
+int createRoom()
+{
+	int roomId = rooms.create();
+	cout << "Created room " << roomId << endl;
+	return roomId;
+}
+
+// claims the OCULUS or LEAP seat of a room and answers the seat's udp token, or an error
+// saying whether the room or the seat is missing or someone else has the seat
+uint64_t joinRoom(int roomId, int role)
+{
+	roomFor(roomId);
+	if (role != OCULUS && role != LEAP)
+		rpc::this_handler().respond_error("No such seat: " + to_string(role));
+	uint64_t token = rooms.join(roomId, role);
+	if (token == 0)
+		rpc::this_handler().respond_error("Seat " + to_string(role) + " of room " + to_string(roomId) + " is taken");
+	cout << "Seat " << role << " of room " << roomId << " joined" << endl;
+	return token;
+}
+
+// gives a seat back so it can be joined again straight away, token is the one joinRoom
+// answered. players that never leave lose their seat after SEAT_TIMEOUT_MS of silence
+void leaveRoom(int roomId, int role, uint64_t token)
+{
+	if (rooms.leave(roomId, role, token))
+		cout << "Seat " << role << " of room " << roomId << " left" << endl;
+}
+
+void closeRoom(int roomId)
+{
+	rooms.close(roomId);
+	cout << "Closed room " << roomId << endl;
+}
+
+// setter for head and hand pose, clients send it as a notification
+void setPose(int roomId, int player, int whichPose, s_Pose pose)
+{
+	Room & room = roomFor(roomId);
+	//cout << "Setting pose " << player << " " << whichPose << endl;
+	room.seen(player);
+	room.poses.set(player, whichPose, pose);
+	++room.worldTick;
+}
+
+// getter for head and hand pose
+s_Pose getPose(int roomId, int player, int whichPose)
+{
+	//cout << "Getting pose " << player << " " << whichPose << endl;
+	return roomFor(roomId).poses.get(player, whichPose);
+}
+
+// both players get the same ball, the second argument is left over from when each had a copy
+s_Mat getBallPose(int roomId, int)
+{
+	//cout << "Getting ball pose..." << endl;
+	return serializeMat(ballMatrix(roomFor(roomId).publishedBall.load().ball));
+}
+
+void oculusReady(int roomId)
+{
+	roomFor(roomId).markReady(OCULUS);
+	cout << "Oculus is ready in room " << roomId << endl;
+}
+
+void leapReady(int roomId)
+{
+	roomFor(roomId).markReady(LEAP);
+	cout << "Leap is ready in room " << roomId << endl;
+}
+
+bool checkConnection(int roomId)
+{
+	if (!roomFor(roomId).bothReady())
+		return false;
+	else
+	{
+		cout << "Both palyers connected in room " << roomId << endl;
+		return true;
+	}
+}
+
+// parks until both players of the room are ready instead of polling checkConnection,
+// returns false if timeoutMs ran out first so the caller can ask again. asking again
+// keeps the waiting player's seat
+bool waitForPeers(int roomId, int player, int timeoutMs)
+{
+	Room & room = roomFor(roomId);
+	room.seen(player);
+	ParkedPoll poll;
+	bool ready = room.waitForPeers(poll.timeout(timeoutMs, MAX_PEER_WAIT_MS));
+	if (ready)
+		cout << "Both palyers connected in room " << roomId << endl;
+	return ready;
+}
+
+// getter for last player to hit the ball
+int getLastPlayer(int roomId)
+{
+	return roomFor(roomId).publishedBall.load().ball.lastPlayer;
+}
+
+// batched setter for a player's input, the only state clients still upload
+// sent as a notification, so no response is packed or written for it. sequence counts
+// up from 1 per player, anything not newer than what the seat already has is dropped.
+void pushPlayerState(int roomId, int player, unsigned int sequence, s_PlayerState state)
+{
+	roomFor(roomId).applyInput(player, sequence, state);
+}
+
+// batched getter for the whole world, only filled in if something changed after sinceTick
+// the player asking keeps its seat
+s_WorldSnapshot getWorldSnapshot(int roomId, int player, unsigned int sinceTick)
+{
+	Room & room = roomFor(roomId);
+	room.seen(player);
+	return room.snapshot(sinceTick);
+}
+
+// long-polled getWorldSnapshot, the worker parks until the next push that changed the
+// room after sinceTick, so subscribers hear about changes without polling and idle
+// rooms send nothing until timeoutMs runs out. this is the rpc fallback, the server
+// pushes snapshots to players on the udp channel.
+// each waiting subscriber holds a worker thread, see setLongPollCapacity, past it the
+// answer comes straight back and the client backs off before asking again
+s_WorldSnapshot subscribeWorld(int roomId, int player, unsigned int sinceTick, int timeoutMs)
+{
+	Room & room = roomFor(roomId);
+	ParkedPoll poll;
+	room.waitForPush(sinceTick, poll.timeout(timeoutMs, MAX_SUBSCRIBE_WAIT_MS));
+	return getWorldSnapshot(roomId, player, sinceTick);
+}
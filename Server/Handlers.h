@@ -0,0 +1,56 @@
+#ifndef HANDLERS_H
+#define HANDLERS_H
+
+#include <string>
+
+#include "SerializablePose.h"
+#include "Rooms.h"
+
+// every match hosted by this process
+extern RoomRegistry rooms;
+
+// rpc handlers, all scoped to a room, answering with an error if the room doesn't exist
+int createRoom();
+uint64_t joinRoom(int roomId, int role);
+void leaveRoom(int roomId, int role, uint64_t token);
+void closeRoom(int roomId);
+void setPose(int roomId, int player, int whichPose, s_Pose pose);
+s_Pose getPose(int roomId, int player, int whichPose);
+s_Mat getBallPose(int roomId, int index);
+void oculusReady(int roomId);
+void leapReady(int roomId);
+bool checkConnection(int roomId);
+bool waitForPeers(int roomId, int player, int timeoutMs);
+int getLastPlayer(int roomId);
+void pushPlayerState(int roomId, int player, unsigned int sequence, s_PlayerState state);
+s_WorldSnapshot getWorldSnapshot(int roomId, int player, unsigned int sinceTick);
+s_WorldSnapshot subscribeWorld(int roomId, int player, unsigned int sinceTick, int timeoutMs);
+
+// most subscribeWorld/waitForPeers calls parked at once, each holds a worker, so the
+// server keeps this below its worker count to leave workers for control calls.
+// a long poll that finds no room answers straight away.
+void setLongPollCapacity(int polls);
+
+// binds every game handler on anything with a bind(name, func), the rpc server and
+// the replay tool share it so a recorded log maps onto the same functions
+template <typename Binder>
+void bindHandlers(Binder & binder)
+{
+	binder.bind("createRoom", &createRoom);
+	binder.bind("joinRoom", &joinRoom);
+	binder.bind("leaveRoom", &leaveRoom);
+	binder.bind("closeRoom", &closeRoom);
+	binder.bind("setPose", &setPose);
+	binder.bind("getPose", &getPose);
+	binder.bind("getLastPlayer", &getLastPlayer);
+	binder.bind("getBallPose", &getBallPose);
+	binder.bind("oculusReady", &oculusReady);
+	binder.bind("leapReady", &leapReady);
+	binder.bind("checkConnection", &checkConnection);
+	binder.bind("waitForPeers", &waitForPeers);
+	binder.bind("pushPlayerState", &pushPlayerState);
+	binder.bind("getWorldSnapshot", &getWorldSnapshot);
+	binder.bind("subscribeWorld", &subscribeWorld);
+}
+
+#endif
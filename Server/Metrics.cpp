@@ -0,0 +1,216 @@
+#include "Metrics.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+// one thread's counters, only that thread writes them so plain loads and stores
+// are enough, they are atomic so collectStats can read them at the same time
+struct MethodCounters
+{
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> sized;
+	std::atomic<uint64_t> bytesIn;
+	std::atomic<uint64_t> bytesOut;
+	std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+};
+
+struct ThreadCounters
+{
+	MethodCounters methods[MAX_METHODS];
+};
+
+static std::vector<std::string> methodNames;
+
+// every thread that ever recorded a call, never freed since rpc workers live until exit
+static std::mutex threadsMutex;
+static std::vector<std::unique_ptr<ThreadCounters>> threads;
+
+static ThreadCounters & localCounters()
+{
+	static thread_local ThreadCounters * local = NULL;
+	if (!local)
+	{
+		std::unique_ptr<ThreadCounters> counters(new ThreadCounters());
+		local = counters.get();
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		threads.push_back(std::move(counters));
+	}
+	return *local;
+}
+
+static void bump(std::atomic<uint64_t> & counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static int bucketFor(uint64_t ns)
+{
+	const uint64_t sub = 1 << HISTOGRAM_SUB_BITS;
+	if (ns < sub)
+		return (int)ns;
+
+	int exponent = 0;
+	for (uint64_t v = ns; v > 1; v >>= 1)
+		++exponent;
+	int index = (exponent - HISTOGRAM_SUB_BITS + 1) * (int)sub + (int)((ns >> (exponent - HISTOGRAM_SUB_BITS)) & (sub - 1));
+	return (index < HISTOGRAM_BUCKETS) ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+// middle of the range of latencies a bucket holds
+static double bucketMiddleNs(int index)
+{
+	const int sub = 1 << HISTOGRAM_SUB_BITS;
+	if (index < sub)
+		return index;
+
+	int exponent = index / sub + HISTOGRAM_SUB_BITS - 1;
+	double width = (double)(1ull << (exponent - HISTOGRAM_SUB_BITS));
+	return (sub + index % sub) * width + width / 2;
+}
+
+int registerMethod(const std::string & name)
+{
+	if (methodNames.size() >= MAX_METHODS)
+		return -1;
+	methodNames.push_back(name);
+	return (int)methodNames.size() - 1;
+}
+
+void recordCall(int method, uint64_t latencyNs)
+{
+	if (method < 0 || method >= MAX_METHODS)
+		return;
+
+	MethodCounters & counters = localCounters().methods[method];
+	bump(counters.calls, 1);
+	bump(counters.buckets[bucketFor(latencyNs)], 1);
+}
+
+bool sampleBytes(int method)
+{
+	if (method < 0 || method >= MAX_METHODS)
+		return false;
+	return localCounters().methods[method].calls.load(std::memory_order_relaxed) % BYTES_SAMPLE_RATE == 0;
+}
+
+void recordBytes(int method, size_t bytesIn, size_t bytesOut)
+{
+	if (method < 0 || method >= MAX_METHODS)
+		return;
+
+	MethodCounters & counters = localCounters().methods[method];
+	bump(counters.sized, 1);
+	bump(counters.bytesIn, bytesIn);
+	bump(counters.bytesOut, bytesOut);
+}
+
+void recordCall(int method, uint64_t latencyNs, size_t bytesIn, size_t bytesOut)
+{
+	recordCall(method, latencyNs);
+	recordBytes(method, bytesIn, bytesOut);
+}
+
+std::vector<s_MethodStats> collectStats()
+{
+	std::vector<s_MethodStats> stats;
+	std::lock_guard<std::mutex> lock(threadsMutex);
+
+	for (size_t m = 0; m < methodNames.size(); ++m)
+	{
+		s_MethodStats method = s_MethodStats();
+		method.name = methodNames[m];
+
+		std::vector<uint64_t> buckets(HISTOGRAM_BUCKETS, 0);
+		uint64_t sized = 0;
+		for (size_t t = 0; t < threads.size(); ++t)
+		{
+			const MethodCounters & counters = threads[t]->methods[m];
+			method.calls += counters.calls.load(std::memory_order_relaxed);
+			sized += counters.sized.load(std::memory_order_relaxed);
+			method.bytesIn += counters.bytesIn.load(std::memory_order_relaxed);
+			method.bytesOut += counters.bytesOut.load(std::memory_order_relaxed);
+			for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+				buckets[b] += counters.buckets[b].load(std::memory_order_relaxed);
+		}
+
+		// scale the sized calls up to every call
+		if (sized > 0)
+		{
+			double scale = (double)method.calls / sized;
+			method.bytesIn = (uint64_t)(method.bytesIn * scale);
+			method.bytesOut = (uint64_t)(method.bytesOut * scale);
+		}
+
+		// walk the histogram once, picking off each percentile as it is passed
+		const double percentiles[3] = { 0.5, 0.99, 0.999 };
+		double * targets[3] = { &method.p50, &method.p99, &method.p999 };
+		uint64_t total = 0, seen = 0;
+		for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+			total += buckets[b];
+		int next = 0;
+		for (int b = 0; b < HISTOGRAM_BUCKETS && total > 0; ++b)
+		{
+			if (buckets[b] == 0)
+				continue;
+			seen += buckets[b];
+			while (next < 3 && seen >= percentiles[next] * total)
+				*targets[next++] = bucketMiddleNs(b) / 1000.0;
+			method.max = bucketMiddleNs(b) / 1000.0;
+		}
+
+		stats.push_back(method);
+	}
+	return stats;
+}
+
+void resetStats()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (size_t t = 0; t < threads.size(); ++t)
+	{
+		for (int m = 0; m < MAX_METHODS; ++m)
+		{
+			MethodCounters & counters = threads[t]->methods[m];
+			counters.calls.store(0, std::memory_order_relaxed);
+			counters.sized.store(0, std::memory_order_relaxed);
+			counters.bytesIn.store(0, std::memory_order_relaxed);
+			counters.bytesOut.store(0, std::memory_order_relaxed);
+			for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+				counters.buckets[b].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void writeStats(std::ostream & out)
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::left << std::setw(20) << "method" << std::right
+		<< std::setw(12) << "calls" << std::setw(14) << "bytes in" << std::setw(14) << "bytes out"
+		<< std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p999 us" << std::setw(10) << "max us" << std::endl;
+
+	std::vector<s_MethodStats> stats = collectStats();
+	out << std::fixed << std::setprecision(1);
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const s_MethodStats & method = stats[i];
+		out << std::left << std::setw(20) << method.name << std::right
+			<< std::setw(12) << method.calls << std::setw(14) << method.bytesIn << std::setw(14) << method.bytesOut
+			<< std::setw(10) << method.p50 << std::setw(10) << method.p99 << std::setw(10) << method.p999 << std::setw(10) << method.max << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool dumpStats(const std::string & path)
+{
+	std::ofstream out(path.c_str(), std::ios::trunc);
+	if (!out)
+		return false;
+	writeStats(out);
+	return true;
+}
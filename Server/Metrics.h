@@ -0,0 +1,164 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <rpc/config.h>
+#include <rpc/msgpack.hpp>
+
+#include "RecordLog.h"
+
+// most methods that can be instrumented
+#define MAX_METHODS 32
+
+// latencies are bucketed by power of two with 8 linear steps inside each, so every
+// bucket is within 12.5% of the value, up to about a minute
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_BUCKETS 272
+
+// arguments and results are only sized on one call in BYTES_SAMPLE_RATE per method and
+// thread, the byte totals are scaled up from those so a call isn't packed twice
+#define BYTES_SAMPLE_RATE 64
+
+// msgpack-rpc's request and response arrays around the arguments and the result, with
+// the message id counted at its largest, a uint32
+#define REQUEST_HEADER_BYTES 7
+#define RESPONSE_HEADER_BYTES 8
+#define NOTIFICATION_HEADER_BYTES 2
+
+// totals for one method across every thread, latencies in microseconds. bytes are what
+// went over the wire for the calls that were sized, scaled up to every call
+struct s_MethodStats
+{
+	std::string name;
+	uint64_t calls;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	double p50;
+	double p99;
+	double p999;
+	double max;
+
+	MSGPACK_DEFINE_MAP(name, calls, bytesIn, bytesOut, p50, p99, p999, max);
+};
+
+// adds a method to the stats and returns its index, call before serving
+int registerMethod(const std::string & name);
+
+// counts a finished call on the calling thread's own counters, takes no locks
+void recordCall(int method, uint64_t latencyNs);
+
+// whether the calling thread should size its next call to method
+bool sampleBytes(int method);
+
+// counts the bytes of one sized call
+void recordBytes(int method, size_t bytesIn, size_t bytesOut);
+
+// counts a finished call along with its bytes, for callers that size every call
+void recordCall(int method, uint64_t latencyNs, size_t bytesIn, size_t bytesOut);
+
+// sums every thread's counters
+std::vector<s_MethodStats> collectStats();
+
+// zeroes every counter, only safe while no thread is recording calls
+void resetStats();
+
+// writes the stats as a table
+void writeStats(std::ostream & out);
+
+// writes the stats as a table, replacing the file
+bool dumpStats(const std::string & path);
+
+// msgpack writer that only counts, for sizing arguments and results without packing them
+struct ByteCounter
+{
+	size_t size;
+	ByteCounter() : size(0) { }
+	void write(const char *, size_t length) { size += length; }
+};
+
+template <typename T>
+size_t packedSize(const T & value)
+{
+	ByteCounter counter;
+	RPCLIB_MSGPACK::pack(counter, value);
+	return counter.size;
+}
+
+// times a call until stop or destruction, so calls that end in an error count too
+class CallTimer
+{
+public:
+	CallTimer(int method) : method(method), stopped(false), start(std::chrono::steady_clock::now()) { }
+
+	~CallTimer()
+	{
+		stop();
+	}
+
+	void stop()
+	{
+		if (stopped)
+			return;
+		stopped = true;
+		std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+		recordCall(method, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+private:
+	int method;
+	bool stopped;
+	std::chrono::steady_clock::time_point start;
+};
+
+// wraps a handler bound as name so every call to it is counted under method, and logged
+// if recording. a sampled call is sized outside the timer, so it doesn't show in the
+// latencies. answers are held back by delayMs when it is set, for benchmarks that play
+// against a far away server
+template <typename R, typename... Args>
+std::function<R(Args...)> instrument(int method, const std::string & name, R (*func)(Args...),
+	const std::atomic<int> * delayMs = NULL)
+{
+	const size_t header = REQUEST_HEADER_BYTES + packedSize(name);
+	return [method, header, func, delayMs](Args... args) -> R {
+		recordArgs(method, args...);
+		size_t bytesIn = sampleBytes(method) ? header + packedSize(std::make_tuple(args...)) : 0;
+		if (delayMs)
+			std::this_thread::sleep_for(std::chrono::milliseconds(delayMs->load(std::memory_order_relaxed)));
+
+		CallTimer timer(method);
+		R result = func(args...);
+		timer.stop();
+		if (bytesIn > 0)
+			recordBytes(method, bytesIn, RESPONSE_HEADER_BYTES + packedSize(result));
+		return result;
+	};
+}
+
+// handlers without a result are notifications, nothing is answered or held back
+template <typename... Args>
+std::function<void(Args...)> instrument(int method, const std::string & name, void (*func)(Args...),
+	const std::atomic<int> * = NULL)
+{
+	const size_t header = NOTIFICATION_HEADER_BYTES + packedSize(name);
+	return [method, header, func](Args... args) {
+		recordArgs(method, args...);
+		size_t bytesIn = sampleBytes(method) ? header + packedSize(std::make_tuple(args...)) : 0;
+
+		CallTimer timer(method);
+		func(args...);
+		timer.stop();
+		if (bytesIn > 0)
+			recordBytes(method, bytesIn, 0);
+	};
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef POSE_STORE_H
+#define POSE_STORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "SerializablePose.h"
+
+// a single value guarded by a seqlock
+// readers never take a lock, they copy the value and retry if a write raced them,
+// so any number of rpc worker threads can read while a writer is publishing.
+// T has to be plain data whose size is a multiple of 4 bytes.
+template <typename T>
+class SeqlockSlot
+{
+public:
+	SeqlockSlot() : sequence(0)
+	{
+		T empty = T();
+		store(empty);
+	}
+
+	void store(const T & value)
+	{
+		uint32_t buffer[WORDS];
+		std::memcpy(buffer, &value, sizeof(T));
+
+		// take the slot by moving the sequence from even to odd, this only ever
+		// waits on another writer, never on a reader
+		uint32_t seq = sequence.load(std::memory_order_relaxed);
+		while ((seq & 1) || !sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+			seq = sequence.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (int i = 0; i < WORDS; ++i)
+			words[i].store(buffer[i], std::memory_order_relaxed);
+
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	T load() const
+	{
+		uint32_t buffer[WORDS];
+		uint32_t before, after;
+
+		do
+		{
+			before = sequence.load(std::memory_order_acquire);
+			for (int i = 0; i < WORDS; ++i)
+				buffer[i] = words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+
+		T value;
+		std::memcpy(&value, buffer, sizeof(T));
+		return value;
+	}
+
+private:
+	static_assert(sizeof(T) % sizeof(uint32_t) == 0, "seqlock values must be a whole number of words");
+	static const int WORDS = sizeof(T) / sizeof(uint32_t);
+
+	std::atomic<uint32_t> sequence;
+	std::atomic<uint32_t> words[WORDS];
+};
+
+// head and hand poses of both players, indexed by OCULUS/LEAP and HEAD/HAND
+class PoseStore
+{
+public:
+	void set(int player, int whichPose, const s_Pose & pose)
+	{
+		slots[player == LEAP ? LEAP : OCULUS][whichPose == HEAD ? HEAD : HAND].store(pose);
+	}
+
+	s_Pose get(int player, int whichPose) const
+	{
+		return slots[player == LEAP ? LEAP : OCULUS][whichPose == HEAD ? HEAD : HAND].load();
+	}
+
+private:
+	SeqlockSlot<s_Pose> slots[2][2];
+};
+
+#endif
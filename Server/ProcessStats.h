@@ -0,0 +1,12 @@
+#ifndef PROCESS_STATS_H
+#define PROCESS_STATS_H
+
+#include <cstddef>
+
+// physical memory the server process holds right now, 0 if the platform can't tell
+size_t residentMemoryBytes();
+
+// user and kernel time every thread of the process used so far, in seconds
+double processCpuSeconds();
+
+#endif
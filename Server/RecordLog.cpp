@@ -0,0 +1,184 @@
+#include "RecordLog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+std::atomic<bool> recordingActive(false);
+
+static std::mutex recordMutex;
+static FILE * recordFile = NULL;
+static std::chrono::steady_clock::time_point recordStart;
+static std::vector<std::string> recordMethods;
+
+static void put32(char * out, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		out[i] = (char)((value >> (i * 8)) & 0xff);
+}
+
+static void put64(char * out, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		out[i] = (char)((value >> (i * 8)) & 0xff);
+}
+
+static uint32_t get32(const char * in)
+{
+	const unsigned char * bytes = (const unsigned char *)in;
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+		value |= (uint32_t)bytes[i] << (i * 8);
+	return value;
+}
+
+static uint64_t get64(const char * in)
+{
+	return (uint64_t)get32(in) | ((uint64_t)get32(in + 4) << 32);
+}
+
+bool startRecording(const std::string & path, const std::vector<std::string> & methods)
+{
+	std::lock_guard<std::mutex> lock(recordMutex);
+	if (recordFile)
+		return false;
+
+	recordFile = std::fopen(path.c_str(), "wb");
+	if (!recordFile)
+		return false;
+	recordMethods = methods;
+	recordMethods.push_back(RECORD_TICK_METHOD);
+
+	char header[12];
+	std::memcpy(header, RECORD_MAGIC, 4);
+	put32(header + 4, RECORD_VERSION);
+	put32(header + 8, (uint32_t)recordMethods.size());
+	std::fwrite(header, 1, sizeof(header), recordFile);
+
+	for (size_t i = 0; i < recordMethods.size(); ++i)
+	{
+		char length[4];
+		put32(length, (uint32_t)recordMethods[i].size());
+		std::fwrite(length, 1, sizeof(length), recordFile);
+		std::fwrite(recordMethods[i].data(), 1, recordMethods[i].size(), recordFile);
+	}
+
+	recordStart = std::chrono::steady_clock::now();
+	recordingActive = true;
+	return true;
+}
+
+void stopRecording()
+{
+	std::lock_guard<std::mutex> lock(recordMutex);
+	recordingActive = false;
+	if (recordFile)
+		std::fclose(recordFile);
+	recordFile = NULL;
+}
+
+void appendRecord(int method, const char * data, size_t size)
+{
+	char header[16];
+	put32(header + 8, (uint32_t)method);
+	put32(header + 12, (uint32_t)size);
+
+	// stamp under the lock so the log is in time order
+	std::lock_guard<std::mutex> lock(recordMutex);
+	if (!recordFile)
+		return;
+	put64(header, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - recordStart).count());
+	std::fwrite(header, 1, sizeof(header), recordFile);
+	std::fwrite(data, 1, size, recordFile);
+}
+
+int recordedMethod(const std::string & name)
+{
+	std::lock_guard<std::mutex> lock(recordMutex);
+	if (!recordFile)
+		return -1;
+	for (size_t i = 0; i < recordMethods.size(); ++i)
+	{
+		if (recordMethods[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void recordTick()
+{
+	if (!isRecording())
+		return;
+
+	// no arguments, an empty msgpack array
+	static const char noArgs = (char)0x90;
+	int method;
+	{
+		std::lock_guard<std::mutex> lock(recordMutex);
+		method = (int)recordMethods.size() - 1;
+	}
+	appendRecord(method, &noArgs, 1);
+}
+
+RecordReader::RecordReader() : firstRecord(0), offset(0)
+{
+}
+
+bool RecordReader::open(const std::string & path)
+{
+	contents.clear();
+	methodNames.clear();
+
+	FILE * file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	char chunk[65536];
+	size_t read;
+	while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+		contents.insert(contents.end(), chunk, chunk + read);
+	std::fclose(file);
+
+	if (contents.size() < 12 || std::memcmp(contents.data(), RECORD_MAGIC, 4) != 0 || get32(&contents[4]) != RECORD_VERSION)
+		return false;
+
+	uint32_t count = get32(&contents[8]);
+	offset = 12;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (offset + 4 > contents.size())
+			return false;
+		uint32_t length = get32(&contents[offset]);
+		offset += 4;
+		if (offset + length > contents.size())
+			return false;
+		methodNames.push_back(std::string(&contents[offset], length));
+		offset += length;
+	}
+
+	firstRecord = offset;
+	return true;
+}
+
+bool RecordReader::next(RecordEntry & entry)
+{
+	if (offset + 16 > contents.size())
+		return false;
+
+	const char * header = &contents[offset];
+	size_t size = get32(header + 12);
+	if (offset + 16 + size > contents.size())
+		return false;
+
+	entry.timeNs = get64(header);
+	entry.method = (int)get32(header + 8);
+	entry.data = header + 16;
+	entry.size = size;
+	offset += 16 + size;
+	return true;
+}
+
+void RecordReader::rewind()
+{
+	offset = firstRecord;
+}
@@ -0,0 +1,88 @@
+#ifndef RECORD_LOG_H
+#define RECORD_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <rpc/config.h>
+#include <rpc/msgpack.hpp>
+
+// append-only log of every rpc call the server handled, for replaying a match offline
+// all integers are little endian and records are packed back to back, so the file can
+// be mapped and walked in place:
+//   "VRPL", version, method count, then per method its name length and name
+//   per call: nanoseconds since recording started (64 bit), method index, argument
+//   size, then the arguments as the msgpack array they arrived as
+// the last method in the table is always RECORD_TICK_METHOD, logged with no arguments
+// each time the simulation steps, so a replay ticks exactly where the server did
+#define RECORD_MAGIC "VRPL"
+#define RECORD_VERSION 1
+#define RECORD_TICK_METHOD "tick"
+
+// set while a log is open, checked before doing any recording work
+extern std::atomic<bool> recordingActive;
+
+// opens the log and writes the method table, indices in it match the ones recorded
+bool startRecording(const std::string & path, const std::vector<std::string> & methods);
+void stopRecording();
+
+// appends one call, safe from any thread
+void appendRecord(int method, const char * data, size_t size);
+
+// index of a method in the open log's table, -1 if it isn't there or nothing is recording
+int recordedMethod(const std::string & name);
+
+// appends a tick, does nothing unless recording
+void recordTick();
+
+inline bool isRecording()
+{
+	return recordingActive.load(std::memory_order_relaxed);
+}
+
+// packs a call's arguments and appends them, does nothing unless recording
+template <typename... Args>
+void recordArgs(int method, const Args &... args)
+{
+	if (!isRecording())
+		return;
+
+	static thread_local RPCLIB_MSGPACK::sbuffer buffer;
+	buffer.clear();
+	RPCLIB_MSGPACK::pack(buffer, std::make_tuple(args...));
+	appendRecord(method, buffer.data(), buffer.size());
+}
+
+// one recorded call, data points into the reader's copy of the file
+struct RecordEntry
+{
+	uint64_t timeNs;
+	int method;
+	const char * data;
+	size_t size;
+};
+
+// walks a log written by startRecording
+class RecordReader
+{
+public:
+	RecordReader();
+
+	bool open(const std::string & path);
+	const std::vector<std::string> & methods() const { return methodNames; }
+
+	// the next call, false at the end of the log or if it was cut short
+	bool next(RecordEntry & entry);
+	void rewind();
+
+private:
+	std::vector<char> contents;
+	std::vector<std::string> methodNames;
+	size_t firstRecord;
+	size_t offset;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "RecordReplay.h"
+
+#include <rpc/this_handler.h>
+#include <rpc/dispatcher.h>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <chrono>
+
+#include "Handlers.h"
+
+// long polls that only wait for the simulation, which never moves while they block here
+static const std::set<std::string> skippedMethods = { "subscribeWorld", "waitForPeers" };
+
+// collects the handlers by name, the same way the server binds them
+struct ReplayBinder
+{
+	std::map<std::string, std::function<void(const RPCLIB_MSGPACK::object &)>> & handlers;
+
+	template <typename F>
+	void bind(const std::string & name, F func)
+	{
+		typedef typename rpc::detail::func_traits<F>::args_type args_type;
+		handlers[name] = [func](const RPCLIB_MSGPACK::object & args) {
+			args_type argsReal;
+			args.convert(argsReal);
+			rpc::detail::call(func, argsReal);
+		};
+	}
+};
+
+RecordReplay::RecordReplay() : calls(0), skipped(0), errors(0), ticks(0), durationNs(0), tickMethod(-1)
+{
+	ReplayBinder binder = { handlers };
+	bindHandlers(binder);
+}
+
+bool RecordReplay::open(const std::string & path)
+{
+	if (!reader.open(path))
+		return false;
+
+	byIndex.clear();
+	tickMethod = -1;
+	for (size_t i = 0; i < reader.methods().size(); ++i)
+	{
+		const std::string & name = reader.methods()[i];
+		if (name == RECORD_TICK_METHOD)
+		{
+			tickMethod = (int)i;
+			byIndex.push_back(NULL);
+			continue;
+		}
+		std::map<std::string, Handler>::const_iterator it = handlers.find(name);
+		bool usable = (it != handlers.end() && skippedMethods.count(name) == 0);
+		byIndex.push_back(usable ? &it->second : NULL);
+		if (it == handlers.end())
+			std::cerr << "No handler for " << name << ", skipping its calls" << std::endl;
+	}
+	return true;
+}
+
+void RecordReplay::run(double speed, const std::function<void()> & onTick)
+{
+	// every run starts from a fresh server with its default room
+	for (int i = 0; i < MAX_ROOMS; ++i)
+		rooms.close(i);
+	rooms.create();
+
+	const uint64_t tickNs = 1000000000ull / TICK_RATE;
+	uint64_t simNs = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	reader.rewind();
+	RecordEntry entry;
+	while (reader.next(entry))
+	{
+		// without recorded ticks, catch the simulation up to the time of the call
+		while (tickMethod < 0 && simNs + tickNs <= entry.timeNs)
+		{
+			rooms.tick(TICK_SECONDS);
+			simNs += tickNs;
+			++ticks;
+			if (onTick)
+				onTick();
+		}
+		durationNs = entry.timeNs;
+
+		if (speed > 0.0)
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds((uint64_t)(entry.timeNs / speed)));
+
+		if (entry.method == tickMethod)
+		{
+			rooms.tick(TICK_SECONDS);
+			++ticks;
+			if (onTick)
+				onTick();
+			continue;
+		}
+
+		if (entry.method < 0 || entry.method >= (int)byIndex.size() || !byIndex[entry.method])
+		{
+			++skipped;
+			continue;
+		}
+
+		try
+		{
+			RPCLIB_MSGPACK::object_handle args = RPCLIB_MSGPACK::unpack(entry.data, entry.size);
+			(*byIndex[entry.method])(args.get());
+			++calls;
+		}
+		catch (rpc::detail::handler_error &)
+		{
+			++errors;
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "Bad record for " << reader.methods()[entry.method] << ": " << e.what() << std::endl;
+			++errors;
+		}
+		rpc::this_handler().clear();
+	}
+}
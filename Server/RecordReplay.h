@@ -0,0 +1,55 @@
+#ifndef RECORD_REPLAY_H
+#define RECORD_REPLAY_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <rpc/config.h>
+#include <rpc/msgpack.hpp>
+
+#include "RecordLog.h"
+
+// feeds a log recorded with Server --record back into the server's handlers, without a
+// network or any players. the simulation ticks where the log says the server ticked, so
+// the same log always ends in the same world. logs from before ticks were recorded are
+// stepped on a grid from the start of the log instead. shared by the replay tool and the
+// benchmarks, the executable has to build Handlers.cpp too.
+class RecordReplay
+{
+public:
+	RecordReplay();
+
+	// opens the log and maps its method indices onto the handlers, calls to methods
+	// this build lacks are skipped
+	bool open(const std::string & path);
+
+	// plays the log once from a fresh server with its default room, calling onTick
+	// after every simulation tick. speed 1 replays in real time, 0 as fast as possible
+	void run(double speed, const std::function<void()> & onTick = std::function<void()>());
+
+	const RecordReader & log() const { return reader; }
+
+	// totals over every run
+	uint64_t calls, skipped, errors, ticks;
+
+	// recorded time of the last call of the last run, in nanoseconds
+	uint64_t durationNs;
+
+private:
+	// what a bound handler becomes, it unpacks the arguments and calls the function
+	typedef std::function<void(const RPCLIB_MSGPACK::object &)> Handler;
+
+	RecordReader reader;
+	std::map<std::string, Handler> handlers;
+
+	// by the log's method index, NULL for methods that are skipped
+	std::vector<const Handler *> byIndex;
+
+	// index of the recorded ticks, -1 if the log has none
+	int tickMethod;
+};
+
+#endif
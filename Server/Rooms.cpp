@@ -0,0 +1,305 @@
+#include "Rooms.h"
+
+#include <chrono>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned int serverTimeMs()
+{
+	return (unsigned int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void Room::push()
+{
+	unsigned int tick = worldTick;
+	if (tick == pushedTick)
+		return;
+
+	// take the lock so a subscriber can't miss the wakeup between its check and its wait
+	{
+		std::lock_guard<std::mutex> lock(pushMutex);
+		pushedTick = tick;
+	}
+	pushed.notify_all();
+}
+
+bool Room::waitForPush(unsigned int sinceTick, int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(pushMutex);
+	return pushed.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() {
+		return !open || (int)(pushedTick - sinceTick) > 0;
+	});
+}
+
+void Room::seen(int player)
+{
+	seatSeenMs[player == LEAP ? LEAP : OCULUS] = serverTimeMs();
+}
+
+void Room::markReady(int role)
+{
+	seen(role);
+	{
+		std::lock_guard<std::mutex> lock(pushMutex);
+		ready[role == LEAP ? LEAP : OCULUS] = true;
+	}
+	peersChanged.notify_all();
+}
+
+bool Room::waitForPeers(int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(pushMutex);
+	peersChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() {
+		return !open || bothReady();
+	});
+	return open && bothReady();
+}
+
+bool Room::applyInput(int player, unsigned int sequence, const s_PlayerState & state)
+{
+	int seat = (player == LEAP) ? LEAP : OCULUS;
+	{
+		// only ever contended by the same player's own notifications
+		std::lock_guard<std::mutex> lock(inputMutex[seat]);
+		if (!sequenceNewer(sequence, inputSequence[seat]))
+			return false;
+		inputSequence[seat] = sequence;
+		seen(seat);
+		poses.set(seat, HEAD, unpackPose(state.head));
+		poses.set(seat, HAND, unpackPose(state.hand));
+	}
+	++worldTick;
+	return true;
+}
+
+unsigned int Room::setInput(int player, const s_PlayerState & state)
+{
+	int seat = (player == LEAP) ? LEAP : OCULUS;
+	unsigned int sequence;
+	{
+		std::lock_guard<std::mutex> lock(inputMutex[seat]);
+		// 0 is never newer, skip it when the sequence wraps
+		sequence = inputSequence[seat] + 1;
+		if (sequence == 0)
+			++sequence;
+		inputSequence[seat] = sequence;
+		seen(seat);
+		poses.set(seat, HEAD, unpackPose(state.head));
+		poses.set(seat, HAND, unpackPose(state.hand));
+	}
+	++worldTick;
+	return sequence;
+}
+
+s_WorldSnapshot Room::snapshot(unsigned int sinceTick) const
+{
+	s_WorldSnapshot snapshot = s_WorldSnapshot();
+	snapshot.tick = worldTick;
+	snapshot.changed = (snapshot.tick != sinceTick);
+	snapshot.serverTimeMs = serverTimeMs();
+
+	if (snapshot.changed)
+	{
+		for (int i = OCULUS; i <= LEAP; ++i)
+		{
+			snapshot.heads[i] = packPose(poses.get(i, HEAD));
+			snapshot.hands[i] = packPose(poses.get(i, HAND));
+		}
+
+		PublishedBall current = publishedBall.load();
+		snapshot.ball = serializeBall(current.ball, current.simTick);
+		snapshot.lastPlayer = current.ball.lastPlayer;
+	}
+
+	return snapshot;
+}
+
+RoomRegistry::RoomRegistry() : rooms(new Room[MAX_ROOMS]), pushInterval(1), ticksSincePush(0)
+{
+	// tokens have to be unguessable, not just unique
+	std::random_device device;
+	std::seed_seq seed = { device(), device(), device(), device() };
+	tokens.seed(seed);
+
+	for (int i = 0; i < MAX_ROOMS; ++i)
+	{
+		rooms[i].open = false;
+		rooms[i].simPlaying = false;
+		reset(rooms[i]);
+	}
+}
+
+void RoomRegistry::reset(Room & room)
+{
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		room.poses.set(i, HEAD, s_Pose());
+		room.poses.set(i, HAND, s_Pose());
+		room.joined[i] = false;
+		room.ready[i] = false;
+		room.udpToken[i] = 0;
+		room.seatSeenMs[i] = 0;
+		room.inputSequence[i] = 0;
+	}
+	room.worldTick = 0;
+	room.pushedTick = 0;
+
+	// the live ball belongs to the simulation thread, it serves a fresh one
+	// once both players are ready again
+	PublishedBall fresh;
+	resetBall(fresh.ball);
+	fresh.simTick = 0;
+	room.publishedBall.store(fresh);
+}
+
+int RoomRegistry::create()
+{
+	for (int i = 0; i < MAX_ROOMS; ++i)
+	{
+		bool expected = false;
+		if (!rooms[i].open && rooms[i].open.compare_exchange_strong(expected, true))
+		{
+			reset(rooms[i]);
+			return i;
+		}
+	}
+	return -1;
+}
+
+void RoomRegistry::close(int roomId)
+{
+	Room * room = find(roomId);
+	if (!room)
+		return;
+
+	// stop the simulation and free the seats before the id can be handed out again
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		room->ready[i] = false;
+		room->udpToken[i] = 0;
+		room->joined[i] = false;
+	}
+	room->open = false;
+
+	// let parked subscribers and lobby waiters go
+	{
+		std::lock_guard<std::mutex> lock(room->pushMutex);
+	}
+	room->pushed.notify_all();
+	room->peersChanged.notify_all();
+}
+
+uint64_t RoomRegistry::join(int roomId, int role)
+{
+	Room * room = find(roomId);
+	if (!room || (role != OCULUS && role != LEAP))
+		return 0;
+
+	bool expected = false;
+	if (!room->joined[role].compare_exchange_strong(expected, true))
+	{
+		// the player in the seat went quiet, only one of the joins racing for it wins
+		unsigned int seen = room->seatSeenMs[role];
+		if (serverTimeMs() - seen <= SEAT_TIMEOUT_MS || !room->seatSeenMs[role].compare_exchange_strong(seen, serverTimeMs()))
+			return 0;
+	}
+	room->seen(role);
+
+	// the new player counts its input from 1 and readies up again
+	{
+		std::lock_guard<std::mutex> lock(room->inputMutex[role]);
+		room->inputSequence[role] = 0;
+	}
+	room->ready[role] = false;
+
+	// the udp channel has no sessions, so the token is what ties a datagram to this seat
+	uint64_t token = 0;
+	{
+		std::lock_guard<std::mutex> lock(tokenMutex);
+		while (token == 0)
+			token = tokens();
+	}
+	room->udpToken[role] = token;
+	return token;
+}
+
+bool RoomRegistry::leave(int roomId, int role, uint64_t token)
+{
+	Room * room = find(roomId);
+	if (!room || (role != OCULUS && role != LEAP) || token == 0)
+		return false;
+
+	// a seat that was taken over has a new token, the old player can't free it
+	if (!room->udpToken[role].compare_exchange_strong(token, 0))
+		return false;
+	{
+		std::lock_guard<std::mutex> lock(room->pushMutex);
+		room->ready[role] = false;
+	}
+	room->joined[role] = false;
+	room->peersChanged.notify_all();
+	return true;
+}
+
+Room * RoomRegistry::find(int roomId)
+{
+	if (roomId < 0 || roomId >= MAX_ROOMS || !rooms[roomId].open)
+		return NULL;
+	return &rooms[roomId];
+}
+
+void RoomRegistry::tick(float dt)
+{
+	bool pushing = (++ticksSincePush >= pushInterval);
+	if (pushing)
+		ticksSincePush = 0;
+
+	for (int i = 0; i < MAX_ROOMS; ++i)
+	{
+		Room & room = rooms[i];
+		if (!room.open)
+			continue;
+
+		if (!room.bothReady())
+		{
+			// still in the lobby, only poses change
+			room.simPlaying = false;
+			if (pushing)
+				room.push();
+			continue;
+		}
+
+		// serve a new ball when a match starts
+		if (!room.simPlaying)
+		{
+			resetBall(room.simBall.ball);
+			room.simBall.simTick = 0;
+			room.simPlaying = true;
+		}
+
+		s_Pose hands[2] = { room.poses.get(OCULUS, HAND), room.poses.get(LEAP, HAND) };
+		stepBall(room.simBall.ball, hands, dt);
+		++room.simBall.simTick;
+		room.publishedBall.store(room.simBall);
+		++room.worldTick;
+
+		if (pushing)
+			room.push();
+	}
+}
+
+void RoomRegistry::setPushRate(int hz)
+{
+	pushInterval = (hz <= 0 || hz >= TICK_RATE) ? 1 : TICK_RATE / hz;
+}
+
+int RoomRegistry::openCount() const
+{
+	int count = 0;
+	for (int i = 0; i < MAX_ROOMS; ++i)
+	{
+		if (rooms[i].open)
+			++count;
+	}
+	return count;
+}
@@ -0,0 +1,152 @@
+#ifndef ROOMS_H
+#define ROOMS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <condition_variable>
+
+#include "SerializablePose.h"
+#include "Simulation.h"
+#include "PoseStore.h"
+
+// most matches a single server process hosts at once
+#define MAX_ROOMS 1024
+
+// longest a subscriber is parked before it gets an unchanged snapshot back
+#define MAX_SUBSCRIBE_WAIT_MS 2000
+
+// longest a player is parked in the lobby before it is told to ask again
+#define MAX_PEER_WAIT_MS 2000
+
+// a seat nobody was heard from in for this long can be joined again, so a client that
+// crashed or lost its connection without leaving doesn't keep the seat for good
+#define SEAT_TIMEOUT_MS 5000
+
+// the ball as last published by the simulation thread
+struct PublishedBall
+{
+	BallState ball;
+	unsigned int simTick;
+};
+
+// all the state of one match
+struct Room
+{
+	// set while the room is handed out
+	std::atomic<bool> open;
+
+	// written by the rpc workers, read by everyone
+	PoseStore poses;
+	std::atomic<bool> joined[2];
+	std::atomic<bool> ready[2];
+
+	// handed to a seat's rpc session when it joins, udp input for the seat has to
+	// carry it, and leaving the seat too. 0 while the seat is free
+	std::atomic<uint64_t> udpToken[2];
+
+	// serverTimeMs the seat's player last called in at
+	std::atomic<unsigned int> seatSeenMs[2];
+
+	// newest pushPlayerState applied per seat. a player's notifications can be handled
+	// by different workers, so one that got there late must not overwrite a newer one
+	unsigned int inputSequence[2];
+	std::mutex inputMutex[2];
+
+	// version of this room's state, bumped on every write
+	std::atomic<unsigned int> worldTick;
+
+	// the simulation thread's live ball and the copy everyone else reads
+	SeqlockSlot<PublishedBall> publishedBall;
+	PublishedBall simBall;
+	bool simPlaying;
+
+	// worldTick as of the last push, subscribers park until it moves past theirs
+	std::atomic<unsigned int> pushedTick;
+	std::mutex pushMutex;
+	std::condition_variable pushed;
+
+	// signalled when a player readies up, lobby waiters park on it under pushMutex
+	std::condition_variable peersChanged;
+
+	bool bothReady() const { return ready[OCULUS] && ready[LEAP]; }
+
+	// keeps a player's seat from timing out, every call from the seat goes through here
+	void seen(int player);
+
+	// stores a player's head and hand unless a newer sequence was already applied,
+	// returns whether it was stored
+	bool applyInput(int player, unsigned int sequence, const s_PlayerState & state);
+
+	// stores a player's head and hand as the seat's next input, for input that was
+	// already put in order on the way in, returns the sequence it was stored under
+	unsigned int setInput(int player, const s_PlayerState & state);
+
+	// marks the OCULUS or LEAP player ready and wakes anyone waiting in the lobby
+	void markReady(int role);
+
+	// parks the calling worker until both players are ready, the room closing or
+	// the timeout, returns whether both are ready
+	bool waitForPeers(int timeoutMs);
+
+	// copies out the world, only filled in if something changed after sinceTick
+	s_WorldSnapshot snapshot(unsigned int sinceTick) const;
+
+	// wakes the subscribers if anything changed since the last push
+	void push();
+
+	// parks the calling worker until a push newer than sinceTick, the room closing
+	// or the timeout, returns false on timeout
+	bool waitForPush(unsigned int sinceTick, int timeoutMs);
+};
+
+// milliseconds since the server started, snapshots are stamped with it
+unsigned int serverTimeMs();
+
+// fixed pool of rooms stored back to back, so the simulation walks one array each tick
+class RoomRegistry
+{
+public:
+	RoomRegistry();
+
+	// hands out a free room and returns its id, or -1 if the server is full
+	int create();
+
+	// releases a room so its id can be handed out again
+	void close(int roomId);
+
+	// claims the OCULUS or LEAP seat of a room and returns the seat's udp token, or 0 if
+	// the room doesn't exist or the seat is taken. a seat that timed out is taken over
+	// with a new token, the old one stops working
+	uint64_t join(int roomId, int role);
+
+	// gives up a seat if token is the one it was joined with, returns whether it did
+	bool leave(int roomId, int role, uint64_t token);
+
+	// returns an open room, or NULL if the id is out of range or not handed out
+	Room * find(int roomId);
+
+	// advances every room whose players are both ready by one tick, and pushes
+	// changes to subscribers every pushInterval ticks
+	void tick(float dt);
+
+	// how often subscribers hear about changes, at most once per tick
+	void setPushRate(int hz);
+
+	int openCount() const;
+
+private:
+	void reset(Room & room);
+
+	std::unique_ptr<Room[]> rooms;
+
+	// udp tokens are drawn from it under tokenMutex
+	std::mt19937_64 tokens;
+	std::mutex tokenMutex;
+	int pushInterval;
+	int ticksSincePush;
+};
+
+#endif
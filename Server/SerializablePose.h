@@ -5,7 +5,13 @@
 #include <rpc/server.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <array>
 #include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 
 // shared defines for RPC parameters
 #define OCULUS 0
@@ -14,25 +20,159 @@
 #define HAND 1
 #define SERVER_IP "127.0.0.1"
 #define SERVER_PORT 8080
+#define DEFAULT_ROOM 0
 
-// serializable pose object
+// optional unreliable channel for the high rate pose traffic
+#define SERVER_UDP_PORT 8081
+#define UDP_REDUNDANCY 2
+#define UDP_HISTORY 16
+#define UDP_MAX_DATAGRAM 1200
+
+// every method is also bound under a compact id, its index in the table returned by
+// getMethodTable packed as a one character string. msgpack-rpc requires the method
+// to be a string, so this is as small as an id gets while plain clients keep working.
+#define METHOD_ID_BASE '0'
+
+inline std::string methodId(int index)
+{
+	return std::string(1, (char)(METHOD_ID_BASE + index));
+}
+
+// packed poses cover positions in [-ARENA_EXTENT, ARENA_EXTENT] meters on each axis
+#define ARENA_EXTENT 4.0f
+#define PACKED_POSE_SIZE 10
+
+// serializable pose object, packed as a plain array of its seven floats
 struct s_Pose
 {
 	float pos_x, pos_y, pos_z;
 	float rot_x, rot_y, rot_z, rot_w;
 
-	MSGPACK_DEFINE_MAP(pos_x, pos_y, pos_z,
+	MSGPACK_DEFINE_ARRAY(pos_x, pos_y, pos_z,
 		rot_x, rot_y, rot_z, rot_w);
 };
 
+// quantized pose for the high rate messages, sent as a 10 byte bin
+// bytes 0-5 are the position as 16 bit fractions of the arena, bytes 6-9 the
+// orientation as the index of its largest component plus the other three at 10 bits
+struct s_PackedPose
+{
+	std::array<char, PACKED_POSE_SIZE> bytes;
+	MSGPACK_DEFINE_ARRAY(bytes);
+};
+
+// serializable 4x4 matrix, column major like glm, stored inline so copies never allocate
 struct s_Mat
 {
-	std::vector<float> values;
-	MSGPACK_DEFINE_MAP(values);
+	std::array<float, 16> values;
+	MSGPACK_DEFINE_ARRAY(values);
+};
+
+// ball as the server simulated it, receivers rebuild the mesh transforms from it
+struct s_BallState
+{
+	float pos_x, pos_y, pos_z;
+	float vel_x, vel_y, vel_z;
+
+	// server simulation tick this state was computed at
+	unsigned int tick;
+
+	MSGPACK_DEFINE_ARRAY(pos_x, pos_y, pos_z,
+		vel_x, vel_y, vel_z, tick);
 };
 
+// everything a single player uploads each frame
+struct s_PlayerState
+{
+	s_PackedPose head;
+	s_PackedPose hand;
+
+	MSGPACK_DEFINE_ARRAY(head, hand);
+};
+
+// versioned copy of the whole world, indexed by OCULUS/LEAP
+struct s_WorldSnapshot
+{
+	unsigned int tick;
+	bool changed;
+
+	// server clock when the snapshot was taken, receivers use it to smooth out jitter
+	unsigned int serverTimeMs;
+
+	std::array<s_PackedPose, 2> heads;
+	std::array<s_PackedPose, 2> hands;
+	s_BallState ball;
+	int lastPlayer;
+
+	MSGPACK_DEFINE_ARRAY(tick, changed, serverTimeMs, heads, hands, ball, lastPlayer);
+};
+
+// a player's input over udp, newer sequence numbers replace older ones
+// token is the one joinRoom handed out for the seat, anything else is dropped.
+// it also acks the newest snapshot the player decoded, or asks for a keyframe
+// if it got a delta against a snapshot it doesn't have
+struct s_UdpInput
+{
+	int roomId;
+	int player;
+	uint64_t token;
+	unsigned int sequence;
+	s_PlayerState state;
+
+	unsigned int ackSequence;
+	bool keyframe;
+
+	MSGPACK_DEFINE_ARRAY(roomId, player, token, sequence, state, ackSequence, keyframe);
+};
+
+// world snapshots over udp, bit packed as deltas against the snapshot numbered
+// baseSequence, or against an empty one if it is 0
+// deltas holds the count, then newest first how many sequence numbers each one is behind
+// sequence followed by its delta. the older ones are repeats in case a datagram was lost.
+struct s_UdpSnapshots
+{
+	unsigned int sequence;
+	unsigned int baseSequence;
+	std::vector<char> deltas;
+
+	MSGPACK_DEFINE_ARRAY(sequence, baseSequence, deltas);
+};
+
+// unpacks datagrams one at a time into a zone and parse stack that are reused, so a
+// steady stream of them never touches the heap. msgpack's own unpack builds a new parse
+// stack for every message. an unpacked object is valid until the next call
+class DatagramReader
+{
+public:
+	DatagramReader() : zone(UDP_MAX_DATAGRAM * 4), context(NULL, NULL, RPCLIB_MSGPACK::unpack_limit()) { }
+
+	// false if the datagram isn't exactly one whole message
+	bool read(const char * data, size_t size, RPCLIB_MSGPACK::object & result)
+	{
+		zone.clear();
+		context.init();
+		context.user().set_zone(zone);
+		context.user().set_referenced(false);
+		size_t offset = 0;
+		if (context.execute(data, size, offset) <= 0 || offset != size)
+			return false;
+		result = context.data();
+		return true;
+	}
+
+private:
+	RPCLIB_MSGPACK::zone zone;
+	RPCLIB_MSGPACK::detail::context context;
+};
+
+// true if sequence number a comes after b, allowing for wraparound
+inline bool sequenceNewer(unsigned int a, unsigned int b)
+{
+	return (int)(a - b) > 0;
+}
+
 // serializes an ovr pose for the server
-s_Pose serializePose(ovrPosef poseIn)
+inline s_Pose serializePose(ovrPosef poseIn)
 {
 	s_Pose retPose;
 
@@ -49,7 +189,7 @@ s_Pose serializePose(ovrPosef poseIn)
 }
 
 // deserializes a server pose for ovr
-ovrPosef deserializePose(s_Pose poseIn)
+inline ovrPosef deserializePose(s_Pose poseIn)
 {
 	ovrVector3f pos;
 	pos.x = poseIn.pos_x;
@@ -68,24 +208,108 @@ ovrPosef deserializePose(s_Pose poseIn)
 	return retPose;
 }
 
-// serialize a glm matrix for the server
-s_Mat serializeMat(glm::mat4 mat)
+// largest magnitude of the three smallest components of a unit quaternion
+#define QUAT_COMPONENT_RANGE 0.70710678f
+
+// quantizes a pose for the wire, positions outside the arena are clamped
+inline s_PackedPose packPose(const s_Pose & pose)
+{
+	s_PackedPose packed;
+
+	const float pos[3] = { pose.pos_x, pose.pos_y, pose.pos_z };
+	for (int i = 0; i < 3; ++i)
+	{
+		float t = std::min(std::max(pos[i] / ARENA_EXTENT, -1.0f), 1.0f);
+		uint16_t bits = (uint16_t)(int16_t)std::lround(t * 32767.0f);
+		packed.bytes[i * 2] = (char)(bits & 0xff);
+		packed.bytes[i * 2 + 1] = (char)(bits >> 8);
+	}
+
+	// smallest three: drop the largest component and rebuild it from the unit length,
+	// flipping the sign first so the dropped one is always positive
+	float rot[4] = { pose.rot_x, pose.rot_y, pose.rot_z, pose.rot_w };
+	float length = std::sqrt(rot[0] * rot[0] + rot[1] * rot[1] + rot[2] * rot[2] + rot[3] * rot[3]);
+	if (length < 1e-6f)
+	{
+		rot[0] = rot[1] = rot[2] = 0.0f;
+		rot[3] = length = 1.0f;
+	}
+
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (std::fabs(rot[i]) > std::fabs(rot[largest]))
+			largest = i;
+	}
+	float sign = (rot[largest] < 0.0f) ? -1.0f : 1.0f;
+
+	uint32_t bits = (uint32_t)largest << 30;
+	int shift = 20;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		float t = std::min(std::max(sign * rot[i] / length / QUAT_COMPONENT_RANGE, -1.0f), 1.0f);
+		bits |= (uint32_t)std::lround((t * 0.5f + 0.5f) * 1023.0f) << shift;
+		shift -= 10;
+	}
+	for (int i = 0; i < 4; ++i)
+		packed.bytes[6 + i] = (char)((bits >> (i * 8)) & 0xff);
+
+	return packed;
+}
+
+// expands a quantized pose back to floats
+inline s_Pose unpackPose(const s_PackedPose & packed)
 {
-	float convertedMat[16] = { 0.0f };
+	const unsigned char * bytes = (const unsigned char *)packed.bytes.data();
+	s_Pose pose;
 
-	const float *pSource = (const float*)glm::value_ptr(mat);
-	for (int i = 0; i < 16; ++i)
-		convertedMat[i] = pSource[i];
+	float pos[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		int16_t value = (int16_t)(uint16_t)(bytes[i * 2] | (bytes[i * 2 + 1] << 8));
+		pos[i] = value / 32767.0f * ARENA_EXTENT;
+	}
+	pose.pos_x = pos[0];
+	pose.pos_y = pos[1];
+	pose.pos_z = pos[2];
 
-	std::vector<float> m(convertedMat, convertedMat + sizeof(convertedMat) / sizeof(convertedMat[0]));
+	uint32_t bits = 0;
+	for (int i = 0; i < 4; ++i)
+		bits |= (uint32_t)bytes[6 + i] << (i * 8);
 
+	int largest = (int)(bits >> 30);
+	float rot[4];
+	float sum = 0.0f;
+	int shift = 20;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		rot[i] = (((bits >> shift) & 0x3ff) / 1023.0f * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+		sum += rot[i] * rot[i];
+		shift -= 10;
+	}
+	rot[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+	pose.rot_x = rot[0];
+	pose.rot_y = rot[1];
+	pose.rot_z = rot[2];
+	pose.rot_w = rot[3];
+	return pose;
+}
+
+// serialize a glm matrix for the server
+inline s_Mat serializeMat(const glm::mat4 & mat)
+{
 	s_Mat ret;
-	ret.values = m;
+	std::memcpy(ret.values.data(), glm::value_ptr(mat), sizeof(float) * 16);
 	return ret;
 }
 
 // deserialize a server matrix for glm
-glm::mat4 deserializeMat(s_Mat mat)
+inline glm::mat4 deserializeMat(const s_Mat & mat)
 {
 	glm::mat4 ret = glm::make_mat4(mat.values.data());
 	return ret;
@@ -1,158 +1,205 @@
 #include <rpc/server.h>
+#ifdef RPCLIB_FROM_SOURCE
+#include <rpc/detail/buffer_pool.h>
+#endif
 #include <LibOVR/OVR_CAPI.h>
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
 
 #include "SerializablePose.h"
+#include "Rooms.h"
+#include "Handlers.h"
+#include "UdpServer.h"
+#include "ProcessStats.h"
+#include "Metrics.h"
+#include "ServerBinder.h"
 using namespace std;
 
-static s_Pose oculus_headPose;
-static s_Pose oculus_handPose;
-static s_Pose leap_headPose;
-static s_Pose leap_handPose;
+// cleared on SIGINT to shut the server down
+static atomic<bool> running(true);
 
-static s_Mat ballPose[2];
+// workers long polls are never allowed to hold, so control calls always get through
+#define CONTROL_WORKERS 1
 
-static int lastPlayer = 0;
+// how often --stats-file is rewritten
+#define STATS_DUMP_SECONDS 10
 
-static bool oculusIsReady = false;
-static bool leapIsReady = false;
-
-// setter for head and hand pose
-void setPose(int player, int whichPose, s_Pose pose)
+// call counts, bytes and latency percentiles of every method since the server started
+vector<s_MethodStats> getStats()
 {
-	if (player == LEAP)
-	{
-		//cout << "Setting leap ";
-		
-		if (whichPose == HEAD)
-		{
-			//cout << "head pose..." << endl;
-			leap_headPose = pose;
-		}
-		else
-		{
-			//cout << "hand pose..." << endl;
-			leap_handPose = pose;
-		}
-	}
-	else
-	{
-		//cout << "Setting oculus ";
-		
-		if (whichPose == HEAD)
-		{
-			//cout << "head pose..." << endl;
-			oculus_headPose = pose;
-		}
-		else
-		{
-			//cout << "hand pose..." << endl;
-			oculus_handPose = pose;
-		}
-	}
+	return collectStats();
 }
 
-// getter for head and hand pose
-s_Pose getPose(int player, int whichPose)
+// advances every room at a fixed rate
+void runSimulation()
 {
-	if (player == LEAP)
-	{
-		//cout << "Getting leap ";
-		
-		if (whichPose == HEAD)
-		{
-			//cout << "head pose..." << endl;
-			return leap_headPose;
-		}
-		else
-		{
-			//cout << "hand pose..." << endl;
-			return leap_handPose;
-		}
-	}
-	else
+	FixedStep clock;
+	chrono::steady_clock::time_point last = chrono::steady_clock::now();
+
+	// report how long a tick of all rooms takes every few seconds
+	chrono::nanoseconds busy(0);
+	int ticks = 0;
+
+	while (running)
 	{
-		//cout << "Getting oculus ";
-		
-		if (whichPose == HEAD)
+		// run a tick for every period that has passed, catching up on at most
+		// MAX_STEPS_PER_UPDATE after the machine was busy
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		int steps = clock.advance(chrono::duration<double>(start - last).count());
+		last = start;
+		for (int i = 0; i < steps; ++i)
 		{
-			//cout << "head pose..." << endl;
-			return oculus_headPose;
+			recordTick();
+			rooms.tick(TICK_SECONDS);
 		}
-		else
+		busy += chrono::steady_clock::now() - start;
+		ticks += steps;
+
+		if (ticks >= TICK_RATE * 10)
 		{
-			//cout << "hand pose..." << endl;
-			return oculus_handPose;
+			int open = rooms.openCount();
+			double tickUs = chrono::duration<double, micro>(busy).count() / ticks;
+			cout << open << " rooms open, " << tickUs << " us per tick";
+			if (open > 0)
+				cout << " (" << tickUs / open << " us per room)";
+			cout << ", " << residentMemoryBytes() / (1024 * 1024) << " MB resident";
+#ifdef RPCLIB_FROM_SOURCE
+			// what the rpc sessions hold in read buffers and the response buffers they share
+			rpc::detail::buffer_pool::usage buffers = rpc::detail::buffer_pool::instance().get_usage();
+			cout << ", " << buffers.sessions << " sessions holding " << buffers.read_buffer_bytes / 1024
+				<< " KB of read buffers, " << buffers.buffer_bytes / 1024 << " KB of response buffers ("
+				<< buffers.buffers_pooled << " pooled)";
+#endif
+			cout << endl;
+			busy = chrono::nanoseconds(0);
+			ticks = 0;
 		}
+
+		this_thread::sleep_for(chrono::duration<double>(clock.untilNextStep()));
 	}
 }
 
-void setBallPose(s_Mat mat, int index)
+void onInterrupt(int)
 {
-	//cout << "Setting ball pose..." << endl;
-	ballPose[index] = mat;
+	running = false;
 }
 
-s_Mat getBallPose(int index)
+void printUsage(const char* program)
 {
-	//cout << "Getting ball pose..." << endl;
-	return ballPose[index];
+	cout << "Usage: " << program << " [--workers N] [--address ADDR] [--port PORT] [--push-rate HZ]"
+		<< " [--udp-port PORT] [--udp-drop RATE] [--udp-delay MS] [--stats-file PATH] [--record PATH]" << endl;
+	cout << "  --udp-port 0 turns the udp pose channel off, --udp-drop and --udp-delay impair it for testing" << endl;
 }
 
-void oculusReady()
+int main(int argc, char* argv[])
 {
-	oculusIsReady = true;
-	cout << "Oculus is ready" << endl;
-}
+	// default to one worker per core listening on every interface
+	size_t workers = max(1u, thread::hardware_concurrency());
+	string address = "0.0.0.0";
+	uint16_t port = rpc::constants::DEFAULT_PORT;
+	uint16_t udpPort = SERVER_UDP_PORT;
+	UdpImpairment impairment = { 0.0f, 0, 0 };
+	string statsFile;
+	string recordFile;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--workers" && i + 1 < argc)
+			workers = max(1, atoi(argv[++i]));
+		else if (arg == "--address" && i + 1 < argc)
+			address = argv[++i];
+		else if (arg == "--port" && i + 1 < argc)
+			port = (uint16_t)atoi(argv[++i]);
+		else if (arg == "--push-rate" && i + 1 < argc)
+			rooms.setPushRate(atoi(argv[++i]));
+		else if (arg == "--udp-port" && i + 1 < argc)
+			udpPort = (uint16_t)atoi(argv[++i]);
+		else if (arg == "--udp-drop" && i + 1 < argc)
+			impairment.dropRate = (float)atof(argv[++i]);
+		else if (arg == "--udp-delay" && i + 1 < argc)
+			impairment.delayMs = atoi(argv[++i]);
+		else if (arg == "--stats-file" && i + 1 < argc)
+			statsFile = argv[++i];
+		else if (arg == "--record" && i + 1 < argc)
+			recordFile = argv[++i];
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
 
-void leapReady()
-{
-	leapIsReady = true;
-	cout << "Leap is ready" << endl;
-}
+	// start the server
+	cout << "Starting server on " << address << ":" << port << " with " << workers << " workers, "
+		<< workers - min(workers, (size_t)CONTROL_WORKERS) << " of them for long polls..." << endl;
+	setLongPollCapacity((int)workers - CONTROL_WORKERS);
+	rpc::server srv(address, port);
 
-bool checkConnection()
-{
-	if (!oculusIsReady || !leapIsReady)
-		return false;
-	else
+	// bind the funtions so they can be called remotely
+	ServerBinder binder(srv);
+	bindHandlers(binder);
+	binder.bindMethodTable();
+	srv.bind("getStats", &getStats);
+
+	// log every call for the replay tool
+	if (!recordFile.empty())
 	{
-		cout << "Both palyers connected" << endl;
-		return true;
+		if (startRecording(recordFile, binder.names))
+			cout << "Recording calls to " << recordFile << endl;
+		else
+			cerr << "Unable to record to " << recordFile << endl;
 	}
-}
 
-// setter for setting the last player to hit the ball
-void setLastPlayer(int playerNum)
-{
-	lastPlayer = playerNum;
-}
+	// the default room is always there so two players can meet without a matchmaker
+	rooms.create();
+	cout << "Hosting up to " << MAX_ROOMS << " rooms, " << sizeof(Room) << " bytes each, "
+		<< residentMemoryBytes() / (1024 * 1024) << " MB resident at startup" << endl;
 
-// getter for last player to hit the ball
-int getLastPlayer()
-{
-	return lastPlayer;
-}
+	// start the authoritative simulation
+	thread simThread(runSimulation);
 
-int main(int argc, char* argv[])
-{
-	// start the server
-	cout << "Starting server..." << endl;
-	rpc::server srv(rpc::constants::DEFAULT_PORT);
-	
-	// bind the funtions so they can be called remotely
-	srv.bind("setPose", &setPose);
-	srv.bind("getPose", &getPose);
-	srv.bind("setLastPlayer", &setLastPlayer);
-	srv.bind("getLastPlayer", &getLastPlayer);
-	srv.bind("setBallPose", &setBallPose);
-	srv.bind("getBallPose", &getBallPose);
-	srv.bind("oculusReady", &oculusReady);
-	srv.bind("leapReady", &leapReady);
-	srv.bind("checkConnection", &checkConnection);
+	// poses can also come and go over udp
+	UdpServer udp(rooms);
+	udp.setImpairment(impairment);
+	if (udpPort != 0)
+	{
+		if (udp.start(udpPort))
+			cout << "Pose channel listening on udp port " << udpPort << endl;
+		else
+			cerr << "Unable to open udp port " << udpPort << ", poses only go over rpc" << endl;
+	}
 
+	// handlers run on the worker pool, this thread just waits for ctrl+c
+	signal(SIGINT, onInterrupt);
 	cout << "Waiting for RPC calls..." << endl;
-	srv.run();
+	srv.async_run(workers);
+	chrono::steady_clock::time_point nextDump = chrono::steady_clock::now() + chrono::seconds(STATS_DUMP_SECONDS);
+	while (running)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+		if (!statsFile.empty() && chrono::steady_clock::now() >= nextDump)
+		{
+			if (!dumpStats(statsFile))
+				cerr << "Unable to write stats to " << statsFile << endl;
+			nextDump += chrono::seconds(STATS_DUMP_SECONDS);
+		}
+	}
+
+	cout << "Shutting down..." << endl;
+	srv.close_sessions();
+	srv.stop();
+	udp.stop();
+	simThread.join();
+	stopRecording();
+	if (!statsFile.empty())
+		dumpStats(statsFile);
 	return 0;
-}
\ No newline at end of file
+}
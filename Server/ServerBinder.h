@@ -0,0 +1,45 @@
+#ifndef SERVER_BINDER_H
+#define SERVER_BINDER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <rpc/server.h>
+
+#include "SerializablePose.h"
+#include "Metrics.h"
+
+// binds methods on an rpc server under their name and their compact id, counting their
+// calls in the stats. the server and the benchmarks that stand one up all bind through it
+struct ServerBinder
+{
+	// delayMs holds back answers, see instrument
+	explicit ServerBinder(rpc::server & srv, const std::atomic<int> * delayMs = NULL) : srv(srv), delayMs(delayMs) { }
+
+	rpc::server & srv;
+	const std::atomic<int> * delayMs;
+
+	// every bound method, the compact id of each is its index
+	std::vector<std::string> names;
+
+	template <typename F>
+	void bind(const std::string & name, F func)
+	{
+		int method = registerMethod(name);
+		std::string id = methodId((int)names.size());
+		srv.bind(name, instrument(method, name, func, delayMs));
+		srv.bind(id, instrument(method, id, func, delayMs));
+		names.push_back(name);
+	}
+
+	// handshake for clients that want to call methods by compact id, bind it once
+	// everything else is bound
+	void bindMethodTable()
+	{
+		std::vector<std::string> table = names;
+		srv.bind("getMethodTable", [table]() { return table; });
+	}
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "Simulation.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+
+s_BallState serializeBall(const BallState & ball, unsigned int tick)
+{
+	s_BallState ret;
+	ret.pos_x = ball.position.x;
+	ret.pos_y = ball.position.y;
+	ret.pos_z = ball.position.z;
+	ret.vel_x = ball.velocity.x;
+	ret.vel_y = ball.velocity.y;
+	ret.vel_z = ball.velocity.z;
+	ret.tick = tick;
+	return ret;
+}
+
+BallState deserializeBall(const s_BallState & ball, int lastPlayer)
+{
+	BallState ret;
+	ret.position = glm::vec3(ball.pos_x, ball.pos_y, ball.pos_z);
+	ret.velocity = glm::vec3(ball.vel_x, ball.vel_y, ball.vel_z);
+	ret.lastPlayer = lastPlayer;
+	return ret;
+}
+
+void resetBall(BallState & ball)
+{
+	ball.position = glm::vec3(0.0f);
+	ball.velocity = glm::vec3(0.0f, 0.0f, BALL_SERVE_SPEED);
+	ball.lastPlayer = 0;
+}
+
+// how far along the move from `from` by `delta` the ball enters the paddle box around
+// a hand, 0 if it starts inside, or -1 if it misses the box
+static float sweepPaddle(const glm::vec3 & from, const glm::vec3 & delta, const s_Pose & hand)
+{
+	glm::vec3 center(hand.pos_x, hand.pos_y, hand.pos_z);
+	glm::vec3 extent = PADDLE_HALF_EXTENT;
+	float enter = 0.0f;
+	float leave = 1.0f;
+
+	// clip the move against each pair of box faces in turn
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float low = center[axis] - extent[axis] - from[axis];
+		float high = center[axis] + extent[axis] - from[axis];
+		if (delta[axis] == 0.0f)
+		{
+			if (low > 0.0f || high < 0.0f)
+				return -1.0f;
+			continue;
+		}
+
+		float t0 = low / delta[axis];
+		float t1 = high / delta[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		leave = std::min(leave, t1);
+		if (enter > leave)
+			return -1.0f;
+	}
+	return enter;
+}
+
+// bounces one axis off the walls at low and high
+static void bounceAxis(float & position, float & velocity, float low, float high)
+{
+	if (position > high && velocity > 0.0f)
+	{
+		position = 2.0f * high - position;
+		velocity = -velocity;
+	}
+	else if (position < low && velocity < 0.0f)
+	{
+		position = 2.0f * low - position;
+		velocity = -velocity;
+	}
+}
+
+void bounceOffWalls(BallState & ball)
+{
+	bounceAxis(ball.position.x, ball.velocity.x, -COURT_HALF_WIDTH, COURT_HALF_WIDTH);
+	bounceAxis(ball.position.y, ball.velocity.y, COURT_FLOOR, COURT_CEILING);
+}
+
+void moveBall(BallState & ball, float dt)
+{
+	float substep = dt / BALL_SUBSTEPS;
+	for (int s = 0; s < BALL_SUBSTEPS; ++s)
+	{
+		ball.position += ball.velocity * substep;
+		bounceOffWalls(ball);
+	}
+}
+
+bool stepBall(BallState & ball, const s_Pose hands[2], float dt)
+{
+	bool hit = false;
+
+	// out past either player, serve again
+	if (ball.position.z > COURT_HALF_LENGTH || ball.position.z < -COURT_HALF_LENGTH)
+	{
+		resetBall(ball);
+	}
+
+	float substep = dt / BALL_SUBSTEPS;
+	for (int s = 0; s < BALL_SUBSTEPS; ++s)
+	{
+		glm::vec3 delta = ball.velocity * substep;
+
+		// send the ball back along the paddle's facing from where it met the paddle,
+		// spending the rest of the substep at the new velocity
+		for (int i = OCULUS; i <= LEAP; ++i)
+		{
+			int playerNum = i + 1;
+			if (ball.lastPlayer == playerNum)
+				continue;
+
+			float t = sweepPaddle(ball.position, delta, hands[i]);
+			if (t < 0.0f)
+				continue;
+
+			glm::quat direc(hands[i].rot_w, hands[i].rot_x, hands[i].rot_y, hands[i].rot_z);
+			glm::vec4 reflect = glm::mat4_cast(direc) * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			ball.position += delta * t;
+			ball.velocity = glm::vec3(reflect) * -BALL_HIT_SPEED;
+			ball.lastPlayer = playerNum;
+			delta = ball.velocity * (substep * (1.0f - t));
+			hit = true;
+		}
+
+		ball.position += delta;
+		bounceOffWalls(ball);
+	}
+	return hit;
+}
+
+FixedStep::FixedStep(double step, int maxSteps) : step(step), maxSteps(maxSteps), accumulator(0.0)
+{
+}
+
+int FixedStep::advance(double elapsed)
+{
+	accumulator += elapsed;
+	int steps = (int)(accumulator / step);
+	if (steps > maxSteps)
+	{
+		// drop the whole steps past the cap, keep the fraction so the phase holds
+		accumulator -= (steps - maxSteps) * step;
+		steps = maxSteps;
+	}
+	accumulator -= steps * step;
+	return steps;
+}
+
+double FixedStep::untilNextStep() const
+{
+	return std::max(0.0, step - accumulator);
+}
+
+void FixedStep::reset()
+{
+	accumulator = 0.0;
+}
+
+glm::mat4 ballMatrix(const BallState & ball)
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), ball.position), glm::vec3(BALL_SCALE));
+}
@@ -0,0 +1,90 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+#include "SerializablePose.h"
+
+// fixed rate the server advances the world at
+#define TICK_RATE 120
+#define TICK_SECONDS (1.0f / TICK_RATE)
+
+// the ball moves in this many substeps per tick so a fast ball can't pass through a
+// paddle or a wall between two steps
+#define BALL_SUBSTEPS 4
+
+// most fixed steps FixedStep hands out at once, time past that is dropped so a stall
+// can't snowball into ever longer catch ups
+#define MAX_STEPS_PER_UPDATE 8
+
+// ball tuning, in world units per second
+#define BALL_SCALE 0.2f
+#define BALL_SERVE_SPEED 6.0f
+#define BALL_HIT_SPEED 3.0f
+
+// half size of the box around a hand pose that counts as the paddle
+#define PADDLE_HALF_EXTENT glm::vec3(0.15f, 0.15f, 0.05f)
+
+// walls the ball bounces off and how far past either end it goes before the next serve
+#define COURT_HALF_WIDTH 1.0f
+#define COURT_CEILING 0.7f
+#define COURT_FLOOR -1.0f
+#define COURT_HALF_LENGTH 3.0f
+
+// headless state of the ball, owned by the server
+struct BallState
+{
+	glm::vec3 position;
+	glm::vec3 velocity;
+
+	// player number (1 or 2) of the last paddle to touch the ball, 0 for none
+	int lastPlayer;
+};
+
+// converts the ball for the wire, stamped with the simulation tick
+s_BallState serializeBall(const BallState & ball, unsigned int tick);
+
+// rebuilds a ball from the wire, lastPlayer travels separately
+BallState deserializeBall(const s_BallState & ball, int lastPlayer);
+
+// puts the ball back in the middle of the court heading toward the leap player
+void resetBall(BallState & ball);
+
+// bounces the ball off any wall, floor or ceiling it has moved past, mirroring it back
+// inside. a ball already heading back in is left alone.
+void bounceOffWalls(BallState & ball);
+
+// advances the ball by dt seconds in BALL_SUBSTEPS substeps, bouncing it off the walls
+// only, for clients dead reckoning between server updates
+void moveBall(BallState & ball, float dt);
+
+// advances the ball by dt seconds in BALL_SUBSTEPS substeps, bouncing it off the walls
+// and the paddles in hands (indexed by OCULUS/LEAP), returns true if a paddle hit the ball.
+// paddles are tested against the path the ball took, not just where it ended up.
+bool stepBall(BallState & ball, const s_Pose hands[2], float dt);
+
+// banks elapsed time and hands it back as whole fixed steps, keeping the fraction for
+// the next call. the same steps give the same results however the time was sliced.
+class FixedStep
+{
+public:
+	FixedStep(double step = TICK_SECONDS, int maxSteps = MAX_STEPS_PER_UPDATE);
+
+	// adds elapsed seconds, returns how many steps are due, at most maxSteps
+	int advance(double elapsed);
+
+	// seconds until the next step is due
+	double untilNextStep() const;
+
+	// forgets any banked time
+	void reset();
+
+private:
+	double step;
+	int maxSteps;
+	double accumulator;
+};
+
+// world matrix the clients draw each ball mesh with
+glm::mat4 ballMatrix(const BallState & ball);
+
+#endif
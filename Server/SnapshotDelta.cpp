@@ -0,0 +1,273 @@
+#include "SnapshotDelta.h"
+
+#include <cstring>
+
+// position differences at most this far from zero are sent in 7 bits instead of 16
+#define SMALL_DELTA_BITS 7
+
+BitWriter::BitWriter(std::vector<char> & out) : out(out), pending(0), pendingBits(0)
+{
+}
+
+BitWriter::~BitWriter()
+{
+	flush();
+}
+
+void BitWriter::write(uint32_t value, int bits)
+{
+	if (bits < 32)
+		value &= (1u << bits) - 1;
+	pending |= (uint64_t)value << pendingBits;
+	pendingBits += bits;
+	while (pendingBits >= 8)
+	{
+		out.push_back((char)(pending & 0xff));
+		pending >>= 8;
+		pendingBits -= 8;
+	}
+}
+
+void BitWriter::writeBool(bool value)
+{
+	write(value ? 1 : 0, 1);
+}
+
+void BitWriter::writeVarUint(uint32_t value)
+{
+	do
+	{
+		write(value & 0x7f, 7);
+		value >>= 7;
+		writeBool(value != 0);
+	} while (value != 0);
+}
+
+void BitWriter::flush()
+{
+	if (pendingBits > 0)
+		out.push_back((char)(pending & 0xff));
+	pending = 0;
+	pendingBits = 0;
+}
+
+BitReader::BitReader(const char * data, size_t size) : data((const unsigned char *)data), size(size), bitOffset(0)
+{
+}
+
+bool BitReader::read(uint32_t & value, int bits)
+{
+	if (bitOffset + bits > size * 8)
+		return false;
+
+	value = 0;
+	for (int i = 0; i < bits; ++i, ++bitOffset)
+	{
+		if (data[bitOffset / 8] & (1 << (bitOffset % 8)))
+			value |= 1u << i;
+	}
+	return true;
+}
+
+bool BitReader::readBool(bool & value)
+{
+	uint32_t bit;
+	if (!read(bit, 1))
+		return false;
+	value = (bit != 0);
+	return true;
+}
+
+bool BitReader::readVarUint(uint32_t & value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		uint32_t group;
+		bool more;
+		if (!read(group, 7) || !readBool(more))
+			return false;
+		value |= group << shift;
+		if (!more)
+			return true;
+	}
+	return false;
+}
+
+// little endian 16 bit position axis of a packed pose
+static uint16_t packedAxis(const s_PackedPose & pose, int axis)
+{
+	const unsigned char * bytes = (const unsigned char *)pose.bytes.data();
+	return (uint16_t)(bytes[axis * 2] | (bytes[axis * 2 + 1] << 8));
+}
+
+static void setPackedAxis(s_PackedPose & pose, int axis, uint16_t value)
+{
+	pose.bytes[axis * 2] = (char)(value & 0xff);
+	pose.bytes[axis * 2 + 1] = (char)(value >> 8);
+}
+
+static uint32_t floatBits(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void encodePose(BitWriter & writer, const s_PackedPose & pose, const s_PackedPose & base)
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		// zigzag so small moves either way become small numbers
+		int16_t delta = (int16_t)(uint16_t)(packedAxis(pose, axis) - packedAxis(base, axis));
+		uint16_t zigzag = (uint16_t)((delta << 1) ^ (delta >> 15));
+
+		writer.writeBool(zigzag != 0);
+		if (zigzag == 0)
+			continue;
+		bool small = (zigzag < (1 << SMALL_DELTA_BITS));
+		writer.writeBool(small);
+		writer.write(zigzag, small ? SMALL_DELTA_BITS : 16);
+	}
+
+	// the orientation bits don't change smoothly, just resend them
+	bool rotated = (std::memcmp(&pose.bytes[6], &base.bytes[6], 4) != 0);
+	writer.writeBool(rotated);
+	if (rotated)
+	{
+		for (int i = 6; i < PACKED_POSE_SIZE; ++i)
+			writer.write((unsigned char)pose.bytes[i], 8);
+	}
+}
+
+static bool decodePose(BitReader & reader, s_PackedPose & pose, const s_PackedPose & base)
+{
+	pose = base;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bool moved, small;
+		uint32_t zigzag;
+		if (!reader.readBool(moved))
+			return false;
+		if (!moved)
+			continue;
+		if (!reader.readBool(small) || !reader.read(zigzag, small ? SMALL_DELTA_BITS : 16))
+			return false;
+
+		int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+		setPackedAxis(pose, axis, (uint16_t)(packedAxis(base, axis) + delta));
+	}
+
+	bool rotated;
+	if (!reader.readBool(rotated))
+		return false;
+	if (rotated)
+	{
+		for (int i = 6; i < PACKED_POSE_SIZE; ++i)
+		{
+			uint32_t byte;
+			if (!reader.read(byte, 8))
+				return false;
+			pose.bytes[i] = (char)byte;
+		}
+	}
+	return true;
+}
+
+static void encodeFloat(BitWriter & writer, float value, float base)
+{
+	bool changed = (floatBits(value) != floatBits(base));
+	writer.writeBool(changed);
+	if (changed)
+		writer.write(floatBits(value), 32);
+}
+
+static bool decodeFloat(BitReader & reader, float & value, float base)
+{
+	bool changed;
+	uint32_t bits;
+	if (!reader.readBool(changed))
+		return false;
+	if (!changed)
+	{
+		value = base;
+		return true;
+	}
+	if (!reader.read(bits, 32))
+		return false;
+	value = bitsFloat(bits);
+	return true;
+}
+
+void encodeSnapshotDelta(BitWriter & writer, const s_WorldSnapshot & snapshot, const s_WorldSnapshot & base)
+{
+	// counters only move forward, send how far
+	writer.writeVarUint(snapshot.tick - base.tick);
+	writer.writeVarUint(snapshot.serverTimeMs - base.serverTimeMs);
+	writer.writeBool(snapshot.changed);
+
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		encodePose(writer, snapshot.heads[i], base.heads[i]);
+		encodePose(writer, snapshot.hands[i], base.hands[i]);
+	}
+
+	encodeFloat(writer, snapshot.ball.pos_x, base.ball.pos_x);
+	encodeFloat(writer, snapshot.ball.pos_y, base.ball.pos_y);
+	encodeFloat(writer, snapshot.ball.pos_z, base.ball.pos_z);
+	encodeFloat(writer, snapshot.ball.vel_x, base.ball.vel_x);
+	encodeFloat(writer, snapshot.ball.vel_y, base.ball.vel_y);
+	encodeFloat(writer, snapshot.ball.vel_z, base.ball.vel_z);
+	writer.writeVarUint(snapshot.ball.tick - base.ball.tick);
+
+	bool hitChanged = (snapshot.lastPlayer != base.lastPlayer);
+	writer.writeBool(hitChanged);
+	if (hitChanged)
+		writer.write((uint32_t)snapshot.lastPlayer, 2);
+}
+
+bool decodeSnapshotDelta(BitReader & reader, s_WorldSnapshot & snapshot, const s_WorldSnapshot & base)
+{
+	uint32_t tickDelta, timeDelta, ballTickDelta;
+	if (!reader.readVarUint(tickDelta) || !reader.readVarUint(timeDelta) || !reader.readBool(snapshot.changed))
+		return false;
+	snapshot.tick = base.tick + tickDelta;
+	snapshot.serverTimeMs = base.serverTimeMs + timeDelta;
+
+	for (int i = OCULUS; i <= LEAP; ++i)
+	{
+		if (!decodePose(reader, snapshot.heads[i], base.heads[i]) ||
+			!decodePose(reader, snapshot.hands[i], base.hands[i]))
+			return false;
+	}
+
+	if (!decodeFloat(reader, snapshot.ball.pos_x, base.ball.pos_x) ||
+		!decodeFloat(reader, snapshot.ball.pos_y, base.ball.pos_y) ||
+		!decodeFloat(reader, snapshot.ball.pos_z, base.ball.pos_z) ||
+		!decodeFloat(reader, snapshot.ball.vel_x, base.ball.vel_x) ||
+		!decodeFloat(reader, snapshot.ball.vel_y, base.ball.vel_y) ||
+		!decodeFloat(reader, snapshot.ball.vel_z, base.ball.vel_z) ||
+		!reader.readVarUint(ballTickDelta))
+		return false;
+	snapshot.ball.tick = base.ball.tick + ballTickDelta;
+
+	bool hitChanged;
+	uint32_t lastPlayer;
+	if (!reader.readBool(hitChanged))
+		return false;
+	snapshot.lastPlayer = base.lastPlayer;
+	if (hitChanged)
+	{
+		if (!reader.read(lastPlayer, 2))
+			return false;
+		snapshot.lastPlayer = (int)lastPlayer;
+	}
+	return true;
+}
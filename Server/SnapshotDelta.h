@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_DELTA_H
+#define SNAPSHOT_DELTA_H
+
+#include <vector>
+#include <cstdint>
+
+#include "SerializablePose.h"
+
+// appends values of any width up to 32 bits to a byte buffer, least significant bit first
+class BitWriter
+{
+public:
+	BitWriter(std::vector<char> & out);
+	~BitWriter();
+
+	void write(uint32_t value, int bits);
+	void writeBool(bool value);
+
+	// small values in 7 bit groups, each followed by a bit saying if another group follows
+	void writeVarUint(uint32_t value);
+
+	// pads the last byte out, also done on destruction
+	void flush();
+
+private:
+	std::vector<char> & out;
+	uint64_t pending;
+	int pendingBits;
+};
+
+// reads what BitWriter wrote, every read fails once the buffer runs out
+class BitReader
+{
+public:
+	BitReader(const char * data, size_t size);
+
+	bool read(uint32_t & value, int bits);
+	bool readBool(bool & value);
+	bool readVarUint(uint32_t & value);
+
+private:
+	const unsigned char * data;
+	size_t size;
+	size_t bitOffset;
+};
+
+// writes the fields of a snapshot that differ from base, a default constructed
+// base gives a keyframe. packed pose positions are sent as small differences when
+// they moved a little, everything else is resent whole when it changed at all.
+void encodeSnapshotDelta(BitWriter & writer, const s_WorldSnapshot & snapshot, const s_WorldSnapshot & base);
+
+// rebuilds a snapshot from base and its delta, returns false if the delta was cut short
+bool decodeSnapshotDelta(BitReader & reader, s_WorldSnapshot & snapshot, const s_WorldSnapshot & base);
+
+#endif
@@ -0,0 +1,194 @@
+#include "UdpServer.h"
+
+#include <iostream>
+
+#include "SnapshotDelta.h"
+#include "RecordLog.h"
+
+UdpServer::UdpServer(RoomRegistry & rooms) : rooms(rooms), running(false), peers(new Peer[MAX_ROOMS * 2])
+{
+	for (int i = 0; i < MAX_ROOMS * 2; ++i)
+	{
+		peers[i].known = false;
+		peers[i].token = 0;
+	}
+}
+
+const s_WorldSnapshot * UdpServer::Peer::sent(unsigned int sequence) const
+{
+	if (sequence == 0 || historySequence[sequence % UDP_HISTORY] != sequence)
+		return NULL;
+	return &history[sequence % UDP_HISTORY];
+}
+
+UdpServer::~UdpServer()
+{
+	stop();
+}
+
+bool UdpServer::start(uint16_t port)
+{
+	if (!socket.open(port))
+		return false;
+	running = true;
+	worker = std::thread(&UdpServer::run, this);
+	return true;
+}
+
+void UdpServer::stop()
+{
+	running = false;
+	if (worker.joinable())
+		worker.join();
+	socket.close();
+}
+
+void UdpServer::setImpairment(const UdpImpairment & impairment)
+{
+	socket.setImpairment(impairment);
+}
+
+void UdpServer::run()
+{
+	char buffer[UDP_MAX_DATAGRAM];
+	UdpEndpoint from;
+
+	while (running)
+	{
+		// wake up at least every millisecond to forward pushes
+		int size = socket.receiveFrom(buffer, sizeof(buffer), from, 1);
+		if (size > 0)
+			receive(buffer, size, from);
+
+		sendSnapshots();
+	}
+}
+
+void UdpServer::receive(const char * data, int size, const UdpEndpoint & from)
+{
+	s_UdpInput input = s_UdpInput();
+	try
+	{
+		RPCLIB_MSGPACK::object message;
+		if (!datagrams.read(data, size, message))
+			return;
+		message.convert(input);
+	}
+	catch (std::exception &)
+	{
+		// not one of ours
+		return;
+	}
+
+	// only the client that joined the seat over rpc knows its token
+	Room * room = rooms.find(input.roomId);
+	if (!room || (input.player != OCULUS && input.player != LEAP))
+		return;
+	uint64_t token = room->udpToken[input.player];
+	if (token == 0 || input.token != token)
+		return;
+
+	// the first datagram with a new token binds the seat to its address, later ones
+	// from anywhere else are dropped until the seat times out or is joined again
+	Peer & peer = peers[input.roomId * 2 + input.player];
+	if (peer.known && peer.token == token && peer.endpoint != from)
+		return;
+	if (!peer.known || peer.token != token)
+	{
+		peer.known = true;
+		peer.token = token;
+		peer.endpoint = from;
+		peer.outputSequence = 0;
+		peer.ackedSequence = 0;
+		peer.sentTick = room->pushedTick - 1;
+		for (int i = 0; i < UDP_HISTORY; ++i)
+			peer.historySequence[i] = 0;
+	}
+	else if (!sequenceNewer(input.sequence, peer.inputSequence))
+	{
+		// stale, a newer input already got through
+		return;
+	}
+	peer.inputSequence = input.sequence;
+	peer.lastHeard = std::chrono::steady_clock::now();
+
+	// newer acks move the delta base forward, a keyframe request drops it
+	if (input.keyframe)
+		peer.ackedSequence = 0;
+	else if (peer.sent(input.ackSequence) && (peer.ackedSequence == 0 || sequenceNewer(input.ackSequence, peer.ackedSequence)))
+		peer.ackedSequence = input.ackSequence;
+
+	// logged as the upload it stands for, so a replay applies it like the rpc path
+	unsigned int sequence = room->setInput(input.player, input.state);
+	if (isRecording())
+	{
+		int method = recordedMethod("pushPlayerState");
+		if (method >= 0)
+			recordArgs(method, input.roomId, input.player, sequence, input.state);
+	}
+}
+
+void UdpServer::sendSnapshots()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	RPCLIB_MSGPACK::sbuffer buffer;
+
+	for (int i = 0; i < MAX_ROOMS * 2; ++i)
+	{
+		Peer & peer = peers[i];
+		if (!peer.known)
+			continue;
+
+		// a seat that was left or taken over has a new token, stop sending to the old address
+		Room * room = rooms.find(i / 2);
+		if (!room || room->udpToken[i % 2] != peer.token || now - peer.lastHeard > std::chrono::milliseconds(UDP_PEER_TIMEOUT_MS))
+		{
+			peer.known = false;
+			continue;
+		}
+
+		unsigned int pushedTick = room->pushedTick;
+		if (pushedTick == peer.sentTick)
+			continue;
+		unsigned int previousTick = peer.sentTick;
+		peer.sentTick = pushedTick;
+
+		// 0 means no snapshot, skip it when the sequence wraps
+		if (++peer.outputSequence == 0)
+			++peer.outputSequence;
+		unsigned int sequence = peer.outputSequence;
+		peer.historySequence[sequence % UDP_HISTORY] = sequence;
+		peer.history[sequence % UDP_HISTORY] = room->snapshot(previousTick);
+
+		// the acked snapshot is the base, unless it has been overwritten since
+		static const s_WorldSnapshot empty = s_WorldSnapshot();
+		const s_WorldSnapshot * base = peer.sent(peer.ackedSequence);
+
+		s_UdpSnapshots datagram;
+		datagram.sequence = sequence;
+		datagram.baseSequence = base ? peer.ackedSequence : 0;
+		if (!base)
+			base = &empty;
+
+		// repeat the snapshots the player hasn't acked yet, newest first
+		int count = 0;
+		while (count < UDP_REDUNDANCY && peer.sent(sequence - count) &&
+			(peer.ackedSequence == 0 || sequenceNewer(sequence - count, peer.ackedSequence)))
+			++count;
+
+		{
+			BitWriter writer(datagram.deltas);
+			writer.writeVarUint(count);
+			for (int j = 0; j < count; ++j)
+			{
+				writer.writeVarUint(j);
+				encodeSnapshotDelta(writer, *peer.sent(sequence - j), *base);
+			}
+		}
+
+		buffer.clear();
+		RPCLIB_MSGPACK::pack(buffer, datagram);
+		if (!socket.sendTo(peer.endpoint, buffer.data(), buffer.size()))
+			std::cerr << "Unable to send a snapshot to room " << i / 2 << std::endl;
+	}
+}
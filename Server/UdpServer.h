@@ -0,0 +1,70 @@
+#ifndef UDP_SERVER_H
+#define UDP_SERVER_H
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
+
+#include "SerializablePose.h"
+#include "Rooms.h"
+#include "UdpSocket.h"
+
+// players that haven't sent input for this long stop getting snapshots
+#define UDP_PEER_TIMEOUT_MS 5000
+
+// unreliable channel for pose traffic next to the rpc server
+// players register by sending s_UdpInput with the token joinRoom gave them, and get an
+// s_UdpSnapshots every time their room pushes. nothing is resent, a stale or lost datagram is just replaced by the next one,
+// so a drop never holds up later poses the way it does on the tcp session.
+// snapshots are sent as deltas against the newest one the player acked, or as a
+// keyframe when there is none or it has fallen out of the history.
+// room joins and readiness stay on rpc.
+class UdpServer
+{
+public:
+	UdpServer(RoomRegistry & rooms);
+	~UdpServer();
+
+	bool start(uint16_t port);
+	void stop();
+
+	void setImpairment(const UdpImpairment & impairment);
+
+private:
+	// where and how far along one seat of a room is
+	struct Peer
+	{
+		bool known;
+		uint64_t token;
+		UdpEndpoint endpoint;
+		std::chrono::steady_clock::time_point lastHeard;
+
+		unsigned int inputSequence;
+		unsigned int outputSequence;
+		unsigned int ackedSequence;
+		unsigned int sentTick;
+
+		// the last snapshots sent, by sequence number modulo UDP_HISTORY
+		unsigned int historySequence[UDP_HISTORY];
+		s_WorldSnapshot history[UDP_HISTORY];
+
+		// a sent snapshot if it is still in the history, NULL otherwise
+		const s_WorldSnapshot * sent(unsigned int sequence) const;
+	};
+
+	void run();
+	void receive(const char * data, int size, const UdpEndpoint & from);
+	void sendSnapshots();
+
+	RoomRegistry & rooms;
+	UdpSocket socket;
+	DatagramReader datagrams;
+	std::thread worker;
+	std::atomic<bool> running;
+
+	// one per seat, indexed by roomId * 2 + player, only touched by the worker
+	std::unique_ptr<Peer[]> peers;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "UdpSocket.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#define CLOSE_SOCKET closesocket
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#define INVALID_SOCKET (-1)
+#define CLOSE_SOCKET ::close
+#endif
+
+#include <cstring>
+
+#ifdef _WIN32
+// winsock has to be started once per process before the first socket
+static bool startWinsock()
+{
+	static bool started = false;
+	if (!started)
+	{
+		WSADATA data;
+		started = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+	}
+	return started;
+}
+#endif
+
+static sockaddr_in toSockaddr(const UdpEndpoint & endpoint)
+{
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(endpoint.address);
+	addr.sin_port = htons(endpoint.port);
+	return addr;
+}
+
+UdpSocket::UdpSocket() : handle((intptr_t)INVALID_SOCKET), random(std::random_device()())
+{
+	impairment.dropRate = 0.0f;
+	impairment.delayMs = 0;
+	impairment.jitterMs = 0;
+}
+
+UdpSocket::~UdpSocket()
+{
+	close();
+}
+
+bool UdpSocket::open(uint16_t port)
+{
+#ifdef _WIN32
+	if (!startWinsock())
+		return false;
+#endif
+	close();
+	handle = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (handle == (intptr_t)INVALID_SOCKET)
+		return false;
+
+	UdpEndpoint any = { INADDR_ANY, port };
+	sockaddr_in addr = toSockaddr(any);
+	if (bind(handle, (sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void UdpSocket::close()
+{
+	if (handle != (intptr_t)INVALID_SOCKET)
+		CLOSE_SOCKET(handle);
+	handle = (intptr_t)INVALID_SOCKET;
+	delayed.clear();
+}
+
+bool UdpSocket::resolve(const std::string & host, uint16_t port, UdpEndpoint & endpoint)
+{
+	in_addr addr;
+	if (inet_pton(AF_INET, host.c_str(), &addr) != 1)
+		return false;
+	endpoint.address = ntohl(addr.s_addr);
+	endpoint.port = port;
+	return true;
+}
+
+bool UdpSocket::sendTo(const UdpEndpoint & to, const char * data, size_t size)
+{
+	flush();
+
+	if (impairment.dropRate > 0.0f && std::uniform_real_distribution<float>(0.0f, 1.0f)(random) < impairment.dropRate)
+		return true;
+
+	int delay = impairment.delayMs;
+	if (impairment.jitterMs > 0)
+		delay += std::uniform_int_distribution<int>(0, impairment.jitterMs)(random);
+	if (delay <= 0)
+		return sendNow(to, data, size);
+
+	Delayed packet;
+	packet.due = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+	packet.to = to;
+	packet.data.assign(data, data + size);
+	delayed.push_back(packet);
+	return true;
+}
+
+bool UdpSocket::sendNow(const UdpEndpoint & to, const char * data, size_t size)
+{
+	sockaddr_in addr = toSockaddr(to);
+	return sendto(handle, data, (int)size, 0, (sockaddr *)&addr, sizeof(addr)) == (int)size;
+}
+
+void UdpSocket::flush()
+{
+	if (delayed.empty())
+		return;
+
+	// jitter can reorder datagrams, just like a real network
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	for (std::deque<Delayed>::iterator it = delayed.begin(); it != delayed.end();)
+	{
+		if (it->due <= now)
+		{
+			sendNow(it->to, it->data.data(), it->data.size());
+			it = delayed.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+int UdpSocket::receiveFrom(char * data, size_t capacity, UdpEndpoint & from, int timeoutMs)
+{
+	flush();
+
+	// wake up in time for the next delayed datagram
+	if (!delayed.empty())
+		timeoutMs = 1;
+
+#ifdef _WIN32
+	WSAPOLLFD fd;
+	fd.fd = (SOCKET)handle;
+	fd.events = POLLRDNORM;
+	if (WSAPoll(&fd, 1, timeoutMs) <= 0)
+		return -1;
+#else
+	pollfd fd;
+	fd.fd = (int)handle;
+	fd.events = POLLIN;
+	if (poll(&fd, 1, timeoutMs) <= 0)
+		return -1;
+#endif
+
+	sockaddr_in addr;
+	socklen_t length = sizeof(addr);
+	int size = (int)recvfrom(handle, data, (int)capacity, 0, (sockaddr *)&addr, &length);
+	if (size < 0)
+		return -1;
+
+	from.address = ntohl(addr.sin_addr.s_addr);
+	from.port = ntohs(addr.sin_port);
+	return size;
+}
+
+void UdpSocket::setImpairment(const UdpImpairment & newImpairment)
+{
+	impairment = newImpairment;
+}
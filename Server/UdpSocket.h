@@ -0,0 +1,71 @@
+#ifndef UDP_SOCKET_H
+#define UDP_SOCKET_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <random>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// ipv4 address and port in host byte order
+struct UdpEndpoint
+{
+	uint32_t address;
+	uint16_t port;
+
+	bool operator==(const UdpEndpoint & other) const { return address == other.address && port == other.port; }
+	bool operator!=(const UdpEndpoint & other) const { return !(*this == other); }
+};
+
+// loss and delay applied to outgoing datagrams, for trying the game on a bad network
+struct UdpImpairment
+{
+	float dropRate;
+	int delayMs;
+	int jitterMs;
+};
+
+// minimal non-connected udp socket over bsd sockets or winsock
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	// binds to the port on every interface, 0 picks any free port
+	bool open(uint16_t port);
+	void close();
+
+	// resolves a dotted ipv4 address
+	static bool resolve(const std::string & host, uint16_t port, UdpEndpoint & endpoint);
+
+	bool sendTo(const UdpEndpoint & to, const char * data, size_t size);
+
+	// waits up to timeoutMs for a datagram, returns its size or -1 if none came
+	int receiveFrom(char * data, size_t capacity, UdpEndpoint & from, int timeoutMs);
+
+	void setImpairment(const UdpImpairment & impairment);
+
+private:
+	struct Delayed
+	{
+		std::chrono::steady_clock::time_point due;
+		UdpEndpoint to;
+		std::vector<char> data;
+	};
+
+	bool sendNow(const UdpEndpoint & to, const char * data, size_t size);
+
+	// sends the delayed datagrams that are due
+	void flush();
+
+	intptr_t handle;
+
+	UdpImpairment impairment;
+	std::deque<Delayed> delayed;
+	std::mt19937 random;
+};
+
+#endif
@@ -0,0 +1,444 @@
+#include <rpc/client.h>
+#include <rpc/rpc_error.h>
+#include <iostream>
+#include <string>
+#include <map>
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "SerializablePose.h"
+#include "Metrics.h"
+using namespace std;
+
+// drives a running server the way a room full of players would, without any VR hardware.
+// every simulated player has its own connection and thread, pairs of them share a room
+// and each one moves its head and hand along a synthetic path every frame.
+
+#define DEFAULT_FRAME_RATE 90
+#define DEFAULT_STAGE_SECONDS 10
+
+// synchronous calls give up after this long, a server that slow is saturated anyway
+#define CALL_TIMEOUT_MS 1000
+
+// longest the players get to connect and ready up before a stage starts without the rest
+#define SETUP_TIMEOUT_MS 10000
+
+// a stage is saturated once it delivers less than this share of the frames it asked for,
+// or a call takes longer than a frame at the 99th percentile
+#define SATURATION_RATIO 0.95
+
+// which calls a player makes per frame
+enum Pattern
+{
+	// the current client: one state notification plus a world snapshot
+	PATTERN_STATE,
+	// the calls ExampleApp::update made per frame before state was batched: both
+	// poses out, the other player's poses and the ball in
+	PATTERN_POSES
+};
+
+struct Options
+{
+	string address;
+	uint16_t port;
+	int players;
+	int rate;
+	double seconds;
+	int ramp;
+	Pattern pattern;
+};
+
+// how a stage went, rates are per second
+struct StageResult
+{
+	int players;
+	double targetFrames;
+	double frames;
+	double calls;
+	double p99Us;
+	uint64_t late;
+	uint64_t failures;
+};
+
+// indices of each method in the stats
+static int statJoin, statReady, statSetPose, statGetPose, statGetBall, statPush, statSnapshot;
+
+// players count themselves in once set up and start their frames on go
+static atomic<int> playersReady;
+static atomic<bool> go;
+static atomic<bool> running;
+
+static atomic<uint64_t> totalFrames;
+static atomic<uint64_t> totalLate;
+static atomic<uint64_t> totalFailures;
+
+// the compact ids the server binds its methods under, empty if it has none
+static map<string, string> fetchMethodTable(rpc::client & client)
+{
+	map<string, string> ids;
+	try
+	{
+		vector<string> names = client.call("getMethodTable").as<vector<string>>();
+		for (size_t i = 0; i < names.size(); ++i)
+			ids[names[i]] = methodId((int)i);
+	}
+	catch (rpc::rpc_error&)
+	{
+	}
+	return ids;
+}
+
+static string method(const map<string, string> & ids, const string & name)
+{
+	map<string, string>::const_iterator it = ids.find(name);
+	return (it != ids.end()) ? it->second : name;
+}
+
+// round trip of a call, counted under stat
+template <typename... Args>
+RPCLIB_MSGPACK::object_handle timedCall(rpc::client & client, int stat, const string & name, Args... args)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	RPCLIB_MSGPACK::object_handle result = client.call(name, args...);
+	chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+	recordCall(stat, (uint64_t)chrono::duration_cast<chrono::nanoseconds>(elapsed).count(),
+		packedSize(make_tuple(args...)), packedSize(result.get()));
+	return result;
+}
+
+// notifications never get an answer, this only counts how long queueing one takes
+template <typename... Args>
+void timedSend(rpc::client & client, int stat, const string & name, Args... args)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	client.send(name, args...);
+	chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+	recordCall(stat, (uint64_t)chrono::duration_cast<chrono::nanoseconds>(elapsed).count(),
+		packedSize(make_tuple(args...)), 0);
+}
+
+// head drifts around a small circle at standing height, each player on its own phase
+static s_Pose syntheticHead(int index, double t)
+{
+	double phase = t * 0.5 + index * 0.7;
+	s_Pose pose;
+	pose.pos_x = (float)(0.2 * cos(phase));
+	pose.pos_y = (float)(1.6 + 0.05 * sin(phase * 2.0));
+	pose.pos_z = (float)(0.2 * sin(phase));
+
+	// turning slowly about the vertical axis
+	double yaw = 0.3 * sin(phase);
+	pose.rot_x = 0.0f;
+	pose.rot_y = (float)sin(yaw / 2.0);
+	pose.rot_z = 0.0f;
+	pose.rot_w = (float)cos(yaw / 2.0);
+	return pose;
+}
+
+// hand swings side to side in front of the head like it is chasing the ball
+static s_Pose syntheticHand(int index, double t)
+{
+	double phase = t * 3.0 + index * 1.3;
+	s_Pose pose;
+	pose.pos_x = (float)(0.5 * sin(phase));
+	pose.pos_y = (float)(1.2 + 0.2 * sin(phase * 0.5));
+	pose.pos_z = -0.4f;
+
+	double roll = 0.5 * sin(phase);
+	pose.rot_x = 0.0f;
+	pose.rot_y = 0.0f;
+	pose.rot_z = (float)sin(roll / 2.0);
+	pose.rot_w = (float)cos(roll / 2.0);
+	return pose;
+}
+
+static void runPlayer(const Options & options, int index, int roomId)
+{
+	const int player = (index % 2 == 0) ? OCULUS : LEAP;
+	const int other = (player == OCULUS) ? LEAP : OCULUS;
+	uint64_t frames = 0, late = 0, failures = 0;
+	bool counted = false;
+
+	try
+	{
+		rpc::client client(options.address, options.port);
+		client.set_timeout(CALL_TIMEOUT_MS);
+		map<string, string> ids = fetchMethodTable(client);
+		const string setPose = method(ids, "setPose");
+		const string getPose = method(ids, "getPose");
+		const string getBallPose = method(ids, "getBallPose");
+		const string pushPlayerState = method(ids, "pushPlayerState");
+		const string getWorldSnapshot = method(ids, "getWorldSnapshot");
+
+		// join and ready up like the client does, then wait for the rest of the stage
+		chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+		try
+		{
+			timedCall(client, statJoin, method(ids, "joinRoom"), roomId, player);
+		}
+		catch (rpc::rpc_error& e)
+		{
+			cerr << "Unable to join room " << roomId << ": " << e.get_error().get().as<string>() << endl;
+			++playersReady;
+			++totalFailures;
+			return;
+		}
+		timedSend(client, statSetPose, setPose, roomId, player, HEAD, syntheticHead(index, 0.0));
+		timedSend(client, statSetPose, setPose, roomId, player, HAND, syntheticHand(index, 0.0));
+		timedCall(client, statReady, method(ids, player == LEAP ? "leapReady" : "oculusReady"), roomId);
+
+		counted = true;
+		++playersReady;
+		while (running && !go)
+			this_thread::sleep_for(chrono::milliseconds(1));
+
+		const chrono::nanoseconds period(1000000000 / options.rate);
+		chrono::steady_clock::time_point next = chrono::steady_clock::now();
+		unsigned int worldTick = 0;
+		unsigned int sequence = 0;
+
+		while (running)
+		{
+			double t = chrono::duration<double>(chrono::steady_clock::now() - epoch).count();
+			s_Pose head = syntheticHead(index, t);
+			s_Pose hand = syntheticHand(index, t);
+
+			try
+			{
+				if (options.pattern == PATTERN_STATE)
+				{
+					s_PlayerState state;
+					state.head = packPose(head);
+					state.hand = packPose(hand);
+					if (++sequence == 0)
+						++sequence;
+					timedSend(client, statPush, pushPlayerState, roomId, player, sequence, state);
+					s_WorldSnapshot snapshot = timedCall(client, statSnapshot, getWorldSnapshot, roomId, player, worldTick).as<s_WorldSnapshot>();
+					if (snapshot.changed)
+						worldTick = snapshot.tick;
+				}
+				else
+				{
+					// the ball used to be uploaded here too, the server simulates it now
+					timedSend(client, statSetPose, setPose, roomId, player, HEAD, head);
+					timedSend(client, statSetPose, setPose, roomId, player, HAND, hand);
+					timedCall(client, statGetPose, getPose, roomId, other, HEAD).as<s_Pose>();
+					timedCall(client, statGetPose, getPose, roomId, other, HAND).as<s_Pose>();
+					timedCall(client, statGetBall, getBallPose, roomId, 0).as<s_Mat>();
+					timedCall(client, statGetBall, getBallPose, roomId, 1).as<s_Mat>();
+				}
+				++frames;
+			}
+			catch (rpc::timeout&)
+			{
+				++failures;
+			}
+			catch (rpc::rpc_error&)
+			{
+				++failures;
+			}
+
+			// a late frame is dropped rather than made up for, like a headset would
+			next += period;
+			chrono::steady_clock::time_point now = chrono::steady_clock::now();
+			if (next < now)
+			{
+				++late;
+				next = now;
+			}
+			this_thread::sleep_until(next);
+		}
+	}
+	catch (exception& e)
+	{
+		cerr << "Player " << index << " lost its connection: " << e.what() << endl;
+		++failures;
+	}
+
+	// a player that never got ready still has to be counted so the stage can start
+	if (!counted)
+		++playersReady;
+	totalFrames += frames;
+	totalLate += late;
+	totalFailures += failures;
+}
+
+static StageResult runStage(const Options & options, int players)
+{
+	StageResult result = StageResult();
+	result.players = players;
+	result.targetFrames = (double)players * options.rate;
+
+	// a room for every pair of players, made on a connection of its own
+	rpc::client control(options.address, options.port);
+	vector<int> roomIds;
+	for (int i = 0; i < (players + 1) / 2; ++i)
+	{
+		int roomId = control.call("createRoom").as<int>();
+		if (roomId < 0)
+		{
+			cerr << "Server is out of rooms after " << roomIds.size() << endl;
+			break;
+		}
+		roomIds.push_back(roomId);
+	}
+	players = min(players, (int)roomIds.size() * 2);
+
+	playersReady = 0;
+	go = false;
+	running = true;
+	totalFrames = 0;
+	totalLate = 0;
+	totalFailures = 0;
+
+	vector<thread> threads;
+	for (int i = 0; i < players; ++i)
+		threads.push_back(thread(runPlayer, cref(options), i, roomIds[i / 2]));
+
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(SETUP_TIMEOUT_MS);
+	while (playersReady < players && chrono::steady_clock::now() < deadline)
+		this_thread::sleep_for(chrono::milliseconds(10));
+	if (playersReady < players)
+		cerr << "Only " << playersReady << " of " << players << " players got ready in time" << endl;
+
+	// only the frames count, not the setup
+	resetStats();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	go = true;
+	this_thread::sleep_for(chrono::duration<double>(options.seconds));
+	running = false;
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	vector<s_MethodStats> stats = collectStats();
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		result.calls += stats[i].calls;
+		if (stats[i].calls > 0)
+			result.p99Us = max(result.p99Us, stats[i].p99);
+	}
+	result.calls /= seconds;
+	result.frames = totalFrames / seconds;
+	result.late = totalLate;
+	result.failures = totalFailures;
+
+	for (size_t i = 0; i < roomIds.size(); ++i)
+		control.call("closeRoom", roomIds[i]);
+	return result;
+}
+
+static bool saturated(const Options & options, const StageResult & result)
+{
+	return result.frames < result.targetFrames * SATURATION_RATIO || result.p99Us > 1000000.0 / options.rate;
+}
+
+static void printStage(const StageResult & result)
+{
+	cout << result.players << " players: " << result.frames << " of " << result.targetFrames << " frames/s ("
+		<< (result.targetFrames > 0.0 ? 100.0 * result.frames / result.targetFrames : 0.0) << "%), "
+		<< result.calls << " calls/s, p99 " << result.p99Us << " us, "
+		<< result.late << " late frames, " << result.failures << " failed calls" << endl;
+}
+
+void printUsage(const char* program)
+{
+	cout << "Usage: " << program << " [--address ADDR] [--port PORT] [--players N] [--rate HZ] [--seconds S]"
+		<< " [--ramp STEP] [--pattern state|poses]" << endl;
+	cout << "  --ramp adds STEP players per stage up to --players and stops at the first saturated stage" << endl;
+	cout << "  --pattern poses makes the separate pose calls of older clients instead of one state push" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	options.address = SERVER_IP;
+	options.port = SERVER_PORT;
+	options.players = 2;
+	options.rate = DEFAULT_FRAME_RATE;
+	options.seconds = DEFAULT_STAGE_SECONDS;
+	options.ramp = 0;
+	options.pattern = PATTERN_STATE;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--address" && i + 1 < argc)
+			options.address = argv[++i];
+		else if (arg == "--port" && i + 1 < argc)
+			options.port = (uint16_t)atoi(argv[++i]);
+		else if (arg == "--players" && i + 1 < argc)
+			options.players = max(1, atoi(argv[++i]));
+		else if (arg == "--rate" && i + 1 < argc)
+			options.rate = max(1, atoi(argv[++i]));
+		else if (arg == "--seconds" && i + 1 < argc)
+			options.seconds = max(0.1, atof(argv[++i]));
+		else if (arg == "--ramp" && i + 1 < argc)
+			options.ramp = max(0, atoi(argv[++i]));
+		else if (arg == "--pattern" && i + 1 < argc && string(argv[i + 1]) == "state")
+		{
+			options.pattern = PATTERN_STATE;
+			++i;
+		}
+		else if (arg == "--pattern" && i + 1 < argc && string(argv[i + 1]) == "poses")
+		{
+			options.pattern = PATTERN_POSES;
+			++i;
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	statJoin = registerMethod("joinRoom");
+	statReady = registerMethod("ready");
+	statSetPose = registerMethod("setPose");
+	statGetPose = registerMethod("getPose");
+	statGetBall = registerMethod("getBallPose");
+	statPush = registerMethod("pushPlayerState");
+	statSnapshot = registerMethod("getWorldSnapshot");
+
+	cout << "Loading " << options.address << ":" << options.port << " at " << options.rate << " frames/s per player" << endl;
+	try
+	{
+		if (options.ramp == 0)
+		{
+			StageResult result = runStage(options, options.players);
+			printStage(result);
+			writeStats(cout);
+			return 0;
+		}
+
+		// add players until the server can't keep up
+		StageResult last = StageResult();
+		for (int players = options.ramp; players <= options.players; players += options.ramp)
+		{
+			StageResult result = runStage(options, players);
+			printStage(result);
+			if (saturated(options, result))
+			{
+				cout << "Saturated at " << players << " players, last kept up with " << last.players << endl;
+				writeStats(cout);
+				return 0;
+			}
+			last = result;
+		}
+		cout << "Kept up with " << last.players << " players" << endl;
+		writeStats(cout);
+	}
+	catch (exception& e)
+	{
+		cerr << "Unable to drive the server at " << options.address << ":" << options.port << endl;
+		cerr << "Reason: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
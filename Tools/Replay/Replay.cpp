@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+#include "SerializablePose.h"
+#include "Handlers.h"
+#include "RecordReplay.h"
+using namespace std;
+
+// replays a log recorded with Server --record as fast as it can or at the recorded pace,
+// then prints where each room's world ended up so two runs can be diffed
+
+void printUsage(const char* program)
+{
+	cout << "Usage: " << program << " LOG [--speed X] [--loops N]" << endl;
+	cout << "  --speed 1 replays in real time, 0 as fast as possible (default)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	string path = argv[1];
+	double speed = 0.0;
+	int loops = 1;
+	for (int i = 2; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--speed" && i + 1 < argc)
+			speed = atof(argv[++i]);
+		else if (arg == "--loops" && i + 1 < argc)
+			loops = max(1, atoi(argv[++i]));
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	RecordReplay replay;
+	if (!replay.open(path))
+	{
+		cerr << "Unable to read " << path << endl;
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int loop = 0; loop < loops; ++loop)
+		replay.run(speed);
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Replayed " << replay.calls << " calls and " << replay.ticks << " ticks in " << seconds << " s ("
+		<< (seconds > 0.0 ? replay.calls / seconds : 0.0) << " calls/s), "
+		<< replay.skipped << " skipped, " << replay.errors << " errors" << endl;
+
+	// a summary of where the world ended up, equal across runs of the same log
+	for (int i = 0; i < MAX_ROOMS; ++i)
+	{
+		Room * room = rooms.find(i);
+		if (!room)
+			continue;
+		PublishedBall ball = room->publishedBall.load();
+		cout << "Room " << i << ": tick " << room->worldTick << ", ball at ("
+			<< ball.ball.position.x << ", " << ball.ball.position.y << ", " << ball.ball.position.z
+			<< ") after " << ball.simTick << " ticks, last hit by " << ball.ball.lastPlayer << endl;
+	}
+	return 0;
+}
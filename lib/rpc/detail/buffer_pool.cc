@@ -0,0 +1,73 @@
+#include "rpc/detail/buffer_pool.h"
+
+#include "rpc/config.h"
+
+namespace rpc {
+namespace detail {
+
+static constexpr std::size_t response_buffer_size =
+    rpc::constants::RESPONSE_BUFFER_SIZE;
+
+buffer_pool &buffer_pool::instance() {
+    // never destroyed, sessions and clients that outlive main's locals may
+    // still give buffers back
+    static buffer_pool *pool = new buffer_pool();
+    return *pool;
+}
+
+pooled_buffer *buffer_pool::take() {
+    {
+        std::lock_guard<std::mutex> lock(mut_);
+        ++in_use_;
+        if (!free_.empty()) {
+            auto buf = free_.back();
+            free_.pop_back();
+            return buf;
+        }
+        buffer_bytes_ += response_buffer_size;
+    }
+    return new pooled_buffer{RPCLIB_MSGPACK::sbuffer(response_buffer_size),
+                             response_buffer_size};
+}
+
+void buffer_pool::give_back(pooled_buffer *buf) {
+    // sbuffer doubles its allocation until the data fits, so this is
+    // where the buffer is at
+    std::size_t capacity = buf->capacity;
+    while (capacity < buf->data.size()) {
+        capacity *= 2;
+    }
+    buf->data.clear();
+
+    std::lock_guard<std::mutex> lock(mut_);
+    --in_use_;
+    buffer_bytes_ += capacity - buf->capacity;
+    buf->capacity = capacity;
+    if (capacity > rpc::constants::MAX_POOLED_BUFFER_SIZE ||
+        free_.size() >= rpc::constants::MAX_POOLED_BUFFERS) {
+        buffer_bytes_ -= capacity;
+        delete buf;
+        return;
+    }
+    free_.push_back(buf);
+}
+
+void buffer_pool::track_read_buffer(std::ptrdiff_t bytes) {
+    read_buffer_bytes_ += bytes;
+}
+
+void buffer_pool::track_session(int count) { sessions_ += count; }
+
+buffer_pool::usage buffer_pool::get_usage() {
+    usage u;
+    u.sessions = static_cast<std::size_t>(sessions_.load());
+    u.read_buffer_bytes = static_cast<std::size_t>(read_buffer_bytes_.load());
+    std::lock_guard<std::mutex> lock(mut_);
+    u.buffers_in_use = in_use_;
+    u.buffers_pooled = free_.size();
+    u.buffer_bytes = buffer_bytes_;
+    return u;
+}
+
+} /* detail */
+} /* rpc */
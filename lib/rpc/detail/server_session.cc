@@ -0,0 +1,241 @@
+#include "rpc/detail/server_session.h"
+
+#include "rpc/config.h"
+#include "rpc/server.h"
+#include "rpc/this_handler.h"
+#include "rpc/this_server.h"
+#include "rpc/this_session.h"
+
+#include "rpc/detail/buffer_pool.h"
+#include "rpc/detail/log.h"
+
+#include <cstring>
+
+namespace rpc {
+namespace detail {
+
+static constexpr std::size_t min_buffer_size =
+    rpc::constants::MIN_SESSION_BUFFER_SIZE;
+// reads that fill the buffer grow it this far, only a single message bigger
+// than this grows it further
+static constexpr std::size_t burst_buffer_size =
+    rpc::constants::DEFAULT_BUFFER_SIZE;
+// this many small reads in a row halve the buffer
+static constexpr unsigned quiet_reads_to_shrink = 64;
+// game messages are small, the zone grows by bigger chunks for ones that
+// are not
+static constexpr std::size_t zone_chunk_size = 2 << 10;
+
+server_session::server_session(server *srv, RPCLIB_ASIO::io_service *io,
+                               RPCLIB_ASIO::ip::tcp::socket socket,
+                               std::shared_ptr<dispatcher> disp,
+                               bool suppress_exceptions)
+    : async_writer(io, std::move(socket)),
+      parent_(srv),
+      io_(io),
+      read_strand_(*io),
+      disp_(disp),
+      read_buf_(new char[min_buffer_size]),
+      read_capacity_(min_buffer_size),
+      ctx_(nullptr, nullptr, RPCLIB_MSGPACK::unpack_limit()),
+      suppress_exceptions_(suppress_exceptions) {
+    zone_ = take_zone();
+    ctx_.init();
+    ctx_.user().set_zone(*zone_);
+    ctx_.user().set_referenced(false);
+    buffer_pool::instance().track_session(1);
+    buffer_pool::instance().track_read_buffer(
+        static_cast<std::ptrdiff_t>(read_capacity_));
+}
+
+server_session::~server_session() {
+    buffer_pool::instance().track_session(-1);
+    buffer_pool::instance().track_read_buffer(
+        -static_cast<std::ptrdiff_t>(read_capacity_));
+}
+
+void server_session::start() { do_read(); }
+
+void server_session::close() {
+    LOG_INFO("Closing session.");
+    exit_ = true;
+    auto self(shared_from_this());
+    write_strand_.post([this, self]() { socket_.close(); });
+}
+
+void server_session::do_read() {
+    auto self(shared_from_this());
+
+    // a message bigger than the buffer grows it, the part of it that was
+    // read stays at the front
+    if (read_end_ == read_capacity_) {
+        resize_read_buffer(read_capacity_ * 2);
+    }
+
+    socket_.async_read_some(
+        RPCLIB_ASIO::buffer(read_buf_.get() + read_end_,
+                            read_capacity_ - read_end_),
+        read_strand_.wrap([this, self](std::error_code ec,
+                                       std::size_t length) {
+            if (!ec) {
+                read_end_ += length;
+                bool filled = read_end_ == read_capacity_;
+                if (!dispatch_buffered()) {
+                    close();
+                    return;
+                }
+                adapt_read_buffer(length, filled);
+                if (!exit_) {
+                    do_read();
+                }
+            } else if (ec == RPCLIB_ASIO::error::eof ||
+                       ec == RPCLIB_ASIO::error::connection_reset) {
+                LOG_INFO("Client disconnected");
+                close();
+            } else {
+                LOG_ERROR("Unhandled error code: {} | '{}'", ec, ec.message());
+            }
+        }));
+    if (exit_) {
+        socket_.close();
+    }
+}
+
+bool server_session::dispatch_buffered() {
+    std::size_t off = 0;
+    while (off < read_end_ && !exit_) {
+        int ret;
+        try {
+            ret = ctx_.execute(read_buf_.get(), read_end_, off);
+        } catch (std::exception &e) {
+            LOG_ERROR("Message over the unpack limits: {}", e.what());
+            return false;
+        }
+        if (ret < 0) {
+            LOG_ERROR("Parse error in a message from the client");
+            return false;
+        }
+        if (ret == 0) {
+            // the rest of the message is still on its way
+            break;
+        }
+
+        // the message lives in its zone until a worker is done with it, the
+        // next one is parsed into a zone that was used before
+        RPCLIB_MSGPACK::object msg = ctx_.data();
+        RPCLIB_MSGPACK::zone *z = zone_.release();
+        zone_ = take_zone();
+        ctx_.init();
+        ctx_.user().set_zone(*zone_);
+        ctx_.user().set_referenced(false);
+
+        // any worker thread can take this call
+        auto self(shared_from_this());
+        io_->post([this, self, msg, z]() {
+            dispatch_one(msg);
+            give_back_zone(z);
+        });
+    }
+
+    // strings are copied into the zones, so nothing refers to the parsed
+    // bytes and the unfinished tail can move to the front
+    std::memmove(read_buf_.get(), read_buf_.get() + off, read_end_ - off);
+    read_end_ -= off;
+    return true;
+}
+
+void server_session::adapt_read_buffer(std::size_t length, bool filled) {
+    // a full buffer after a read means the socket likely has more waiting,
+    // a bigger one takes the rest of a burst in fewer reads
+    if (filled) {
+        quiet_reads_ = 0;
+        if (read_capacity_ < burst_buffer_size && read_end_ < read_capacity_) {
+            resize_read_buffer(read_capacity_ * 2);
+        }
+        return;
+    }
+
+    if (length > read_capacity_ / 4) {
+        quiet_reads_ = 0;
+        return;
+    }
+
+    // after a burst an idle session goes back to a small buffer
+    if (++quiet_reads_ >= quiet_reads_to_shrink &&
+        read_capacity_ > min_buffer_size && read_end_ <= read_capacity_ / 2) {
+        quiet_reads_ = 0;
+        resize_read_buffer(read_capacity_ / 2);
+    }
+}
+
+void server_session::resize_read_buffer(std::size_t capacity) {
+    std::unique_ptr<char[]> resized(new char[capacity]);
+    std::memcpy(resized.get(), read_buf_.get(), read_end_);
+    read_buf_ = std::move(resized);
+    buffer_pool::instance().track_read_buffer(
+        static_cast<std::ptrdiff_t>(capacity) -
+        static_cast<std::ptrdiff_t>(read_capacity_));
+    read_capacity_ = capacity;
+}
+
+void server_session::dispatch_one(RPCLIB_MSGPACK::object const &msg) {
+    this_handler().clear();
+    this_session().clear();
+    this_server().cancel_stop();
+
+    // the dispatcher packs the response straight into a pooled buffer that
+    // goes on the write queue
+    pooled_buffer *out = buffer_pool::instance().take();
+    bool respond;
+    try {
+        respond = disp_->dispatch(msg, out->data, suppress_exceptions_);
+    } catch (...) {
+        buffer_pool::instance().give_back(out);
+        throw;
+    }
+    if (respond) {
+        auto self(shared_from_this());
+        write_strand_.post([this, self, out]() { write(out); });
+    } else {
+        buffer_pool::instance().give_back(out);
+    }
+
+    if (this_session().exit_) {
+        LOG_WARN("Session exit requested from a handler.");
+        // posting through the strand so this comes after
+        // the previous write
+        auto self(shared_from_this());
+        write_strand_.post([this, self]() { close(); });
+    }
+
+    if (this_server().stopping_) {
+        LOG_WARN("Server exit requested from a handler.");
+        // posting through the strand so this comes after
+        // the previous write
+        auto self(shared_from_this());
+        write_strand_.post([this, self]() { parent_->close_sessions(); });
+    }
+}
+
+std::unique_ptr<RPCLIB_MSGPACK::zone> server_session::take_zone() {
+    {
+        std::lock_guard<std::mutex> lock(zones_mutex_);
+        if (!free_zones_.empty()) {
+            auto z = std::move(free_zones_.back());
+            free_zones_.pop_back();
+            return z;
+        }
+    }
+    return rpc::detail::make_unique<RPCLIB_MSGPACK::zone>(zone_chunk_size);
+}
+
+void server_session::give_back_zone(RPCLIB_MSGPACK::zone *z) {
+    // clearing keeps the zone's first chunk, so the next message parsed into
+    // it doesn't allocate
+    z->clear();
+    std::lock_guard<std::mutex> lock(zones_mutex_);
+    free_zones_.emplace_back(z);
+}
+
+} /* detail */
+} /* rpc */
@@ -0,0 +1,256 @@
+#include "rpc/dispatcher.h"
+#include "format.h"
+#include "rpc/detail/client_error.h"
+#include "rpc/this_handler.h"
+
+#include <cstring>
+
+namespace rpc {
+namespace detail {
+
+// how many seeds are tried at one table size before it is doubled
+static constexpr uint32_t seeds_per_size = 64;
+
+void dispatcher::dispatch(RPCLIB_MSGPACK::sbuffer const &msg) {
+    auto unpacked = RPCLIB_MSGPACK::unpack(msg.data(), msg.size());
+    RPCLIB_MSGPACK::sbuffer out;
+    dispatch(unpacked.get(), out);
+}
+
+bool dispatcher::dispatch(RPCLIB_MSGPACK::object const &msg,
+                          RPCLIB_MSGPACK::sbuffer &out,
+                          bool suppress_exceptions) {
+    if (msg.type != RPCLIB_MSGPACK::type::ARRAY) {
+        return false;
+    }
+
+    switch (msg.via.array.size) {
+    case 3:
+        dispatch_notification(msg, suppress_exceptions);
+        return false;
+    case 4:
+        return dispatch_call(msg, out, suppress_exceptions);
+    default:
+        return false;
+    }
+}
+
+// [1, id, error, nil] as the msgpack-rpc spec has it
+template <typename T>
+static void pack_error(RPCLIB_MSGPACK::sbuffer &out, uint32_t id,
+                       T const &error) {
+    out.clear();
+    RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(out);
+    pk.pack_array(4);
+    pk.pack_uint8(1);
+    pk.pack_uint32(id);
+    pk.pack(error);
+    pk.pack_nil();
+}
+
+// [1, id, nil, result]
+static void pack_result_header(RPCLIB_MSGPACK::sbuffer &out, uint32_t id) {
+    out.clear();
+    RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(out);
+    pk.pack_array(4);
+    pk.pack_uint8(1);
+    pk.pack_uint32(id);
+    pk.pack_nil();
+}
+
+static std::string name_of(RPCLIB_MSGPACK::object const &name) {
+    if (name.type != RPCLIB_MSGPACK::type::STR) {
+        return std::string();
+    }
+    return std::string(name.via.str.ptr, name.via.str.size);
+}
+
+bool dispatcher::dispatch_call(RPCLIB_MSGPACK::object const &msg,
+                               RPCLIB_MSGPACK::sbuffer &out,
+                               bool suppress_exceptions) {
+    // the parts are read where they are, the name and the arguments are
+    // never copied out of the message
+    RPCLIB_MSGPACK::object const *parts = msg.via.array.ptr;
+    auto id = parts[1].as<uint32_t>();
+    auto const &name = parts[2];
+    auto const &args = parts[3];
+
+    adaptor_type const *func = find(name);
+    if (!func) {
+        pack_error(out, id,
+                   RPCLIB_FMT::format("rpclib: server could not find "
+                                      "function '{0}' with argument count {1}.",
+                                      name_of(name), args.via.array.size));
+        return true;
+    }
+
+    LOG_DEBUG("Dispatching call to '{}'", name_of(name));
+    try {
+        pack_result_header(out, id);
+        result_packer pk(out);
+        (*func)(args, &pk);
+    } catch (rpc::detail::handler_error &) {
+        // the error was set in this_handler, it is packed below
+    } catch (rpc::detail::handler_spec_response &) {
+        // the response was set in this_handler, it is packed below
+    } catch (std::exception &e) {
+        if (!suppress_exceptions) {
+            throw;
+        }
+        pack_error(out, id,
+                   RPCLIB_FMT::format("rpclib: function '{0}' (called with {1} "
+                                      "arg(s)) "
+                                      "threw an exception. The exception "
+                                      "contained this information: {2}.",
+                                      name_of(name), args.via.array.size,
+                                      e.what()));
+        return true;
+    } catch (...) {
+        if (!suppress_exceptions) {
+            throw;
+        }
+        pack_error(out, id,
+                   RPCLIB_FMT::format("rpclib: function '{0}' (called with {1} "
+                                      "arg(s)) threw an exception. The exception "
+                                      "is not derived from std::exception. No "
+                                      "further information available.",
+                                      name_of(name), args.via.array.size));
+        return true;
+    }
+
+    // There are various things that decide what to send
+    // as a response. They have a precedence.
+
+    // First, if the response is disabled, that wins
+    if (!this_handler().resp_enabled_) {
+        return false;
+    }
+
+    // Second, if there is an error set, we send that
+    // and only third, if there is a special response, we
+    // use it
+    if (!this_handler().error_.get().is_nil()) {
+        LOG_WARN("There was an error set in the handler");
+        pack_error(out, id, this_handler().error_.get());
+    } else if (!this_handler().resp_.get().is_nil()) {
+        LOG_WARN("There was a special result set in the handler");
+        pack_result_header(out, id);
+        RPCLIB_MSGPACK::pack(out, this_handler().resp_.get());
+    }
+    return true;
+}
+
+void dispatcher::dispatch_notification(RPCLIB_MSGPACK::object const &msg,
+                                       bool suppress_exceptions) {
+    RPCLIB_MSGPACK::object const *parts = msg.via.array.ptr;
+    auto const &name = parts[1];
+    auto const &args = parts[2];
+
+    adaptor_type const *func = find(name);
+    if (!func) {
+        LOG_WARN("Notification for unknown function '{}'", name_of(name));
+        return;
+    }
+
+    LOG_DEBUG("Dispatching notification to '{}'", name_of(name));
+    try {
+        (*func)(args, nullptr);
+    } catch (rpc::detail::handler_error &) {
+        // nothing is sent back for notifications
+    } catch (rpc::detail::handler_spec_response &) {
+        // nothing is sent back for notifications
+    } catch (...) {
+        if (!suppress_exceptions) {
+            throw;
+        }
+    }
+}
+
+void dispatcher::add(std::string const &name, adaptor_type func) {
+    for (auto const &e : funcs_) {
+        if (e.name == name) {
+            return;
+        }
+    }
+    funcs_.push_back(entry{name, std::move(func)});
+    rebuild_table();
+}
+
+dispatcher::adaptor_type const *
+dispatcher::find(RPCLIB_MSGPACK::object const &name) const {
+    if (name.type != RPCLIB_MSGPACK::type::STR || slots_.empty()) {
+        return nullptr;
+    }
+
+    char const *data = name.via.str.ptr;
+    std::size_t size = name.via.str.size;
+    uint16_t slot = slots_[hash(seed_, data, size) & (slots_.size() - 1)];
+    if (slot == 0) {
+        return nullptr;
+    }
+
+    entry const &e = funcs_[slot - 1];
+    if (e.name.size() != size || std::memcmp(e.name.data(), data, size) != 0) {
+        return nullptr;
+    }
+    return &e.func;
+}
+
+void dispatcher::rebuild_table() {
+    std::size_t size = 8;
+    while (size < funcs_.size() * 2) {
+        size *= 2;
+    }
+
+    // a handful of names spread over twice as many slots find a seed with
+    // no collisions in a few tries, a bigger table makes it likelier still
+    std::vector<uint16_t> slots;
+    for (;; size *= 2) {
+        for (uint32_t seed = 0; seed < seeds_per_size; ++seed) {
+            slots.assign(size, 0);
+            bool collided = false;
+            for (std::size_t i = 0; i < funcs_.size() && !collided; ++i) {
+                auto const &name = funcs_[i].name;
+                auto &slot = slots[hash(seed, name.data(), name.size()) &
+                                   (size - 1)];
+                collided = slot != 0;
+                slot = static_cast<uint16_t>(i + 1);
+            }
+            if (!collided) {
+                slots_.swap(slots);
+                seed_ = seed;
+                return;
+            }
+        }
+    }
+}
+
+uint32_t dispatcher::hash(uint32_t seed, char const *data, std::size_t size) {
+    // FNV-1a with the seed folded into the basis, then a finalizer so the
+    // low bits the table uses depend on every byte
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+void dispatcher::enforce_arg_count(std::string const &func, std::size_t found,
+                                   std::size_t expected) {
+    using detail::client_error;
+    if (found != expected) {
+        throw client_error(
+            client_error::code::wrong_arity,
+            RPCLIB_FMT::format(
+                "Function '{0}' was called with an invalid number of "
+                "arguments. Expected: {1}, got: {2}",
+                func, expected, found));
+    }
+}
+
+} /* detail */
+} /* rpc */